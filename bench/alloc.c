@@ -0,0 +1,31 @@
+#include "stddef.h"
+#include "stdint.h"
+
+#include "bench/bench.h"
+
+/// The linker sends every allocation made by the benchmarks and the shell
+/// through these wrappers, so that they can be counted.
+static uint64_t allocations = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  allocations++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  allocations++;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  allocations++;
+  return __real_realloc(ptr, size);
+}
+
+uint64_t bench_allocations() {
+  return allocations;
+}
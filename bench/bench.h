@@ -0,0 +1,50 @@
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+#include "time.h"
+
+#include "include/string_arena.h"
+
+/// Get the current time, in nanoseconds, from a monotonic clock.
+static inline uint64_t bench_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/// The number of allocations made since the benchmarks started.
+///
+/// This counts calls to malloc, calloc and realloc, made anywhere in the
+/// benchmark binary, including inside of the shell's code.
+uint64_t bench_allocations();
+
+/// Report the result of a single benchmark.
+///
+/// Results are printed as a tab separated line, so that the output of
+/// different runs can be diffed, or processed by other tools. Throughput is
+/// left out if `bytes` is 0.
+void bench_report(char const *name, uint64_t ops, uint64_t allocs,
+                  uint64_t bytes, uint64_t elapsed_ns);
+
+/// Generate a script made of commands with arguments, pipes and redirects.
+///
+/// Arguments are at most arg_len bytes long. If quoted is set, some of them
+/// are quoted, or contain escapes. The same script is generated on each run.
+/// The result should be freed by the caller.
+StringSlice bench_generate_script(size_t arg_len, bool quoted);
+
+/// Benchmarks for the lexer, on large generated scripts.
+void bench_lexer();
+
+/// Benchmarks comparing the tree and single pass front ends.
+void bench_parser();
+
+/// Benchmarks for each stage, from lexing to interpreting, on workloads
+/// stressing different parts of the syntax.
+void bench_stages();
+
+/// Benchmarks for dispatching bytecode in the interpreter, on programs made
+/// of many cheap operations.
+void bench_dispatch();
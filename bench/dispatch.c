@@ -0,0 +1,78 @@
+#include "stdlib.h"
+#include "string.h"
+
+#include "bench/bench.h"
+#include "include/compiler.h"
+#include "include/interpreter.h"
+#include "include/parser.h"
+
+/// How many bytes of script each workload has, roughly.
+static const size_t WORKLOAD_SIZE = 1 << 20;
+
+/// How many times each benchmark runs, keeping the fastest.
+static const int REPETITIONS = 5;
+
+static void check(Error err) {
+  if (err.type != ERROR_NONE) {
+    fprintf(stderr, "dispatch: %s\n", error_str(err));
+    abort();
+  }
+}
+
+/// Compile a statement repeated many times, and run it in the interpreter.
+///
+/// Only builtins which don't print anything are used, so that the time is
+/// spent going from one operation to the next, rather than in processes or
+/// output. An operation is a single bytecode operation.
+static void run(char const *name, char const *statement) {
+  size_t len = strlen(statement);
+  size_t count = WORKLOAD_SIZE / len + 1;
+  char *script = malloc(count * len);
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(script + i * len, statement, len);
+  }
+
+  StringArena *arena = string_arena_init();
+  SymbolTable *symbols = symbol_table_init();
+  OpBuffer *ops = op_buffer_init();
+  Lexer lexer =
+      lexer_init((StringSlice){.data = script, .len = count * len}, arena);
+  Parser parser = parser_init(&lexer, NULL);
+  check(compile_direct(&parser, ops));
+  op_buffer_link(ops, arena, symbols);
+  Interpreter *interpreter = interpreter_init(arena, symbols);
+
+  uint64_t best = UINT64_MAX;
+  uint64_t allocs = 0;
+  for (int rep = 0; rep < REPETITIONS; ++rep) {
+    interpreter_reset(interpreter);
+    uint64_t allocs_start = bench_allocations();
+    uint64_t start = bench_now_ns();
+    check(interpreter_run(interpreter, ops));
+    uint64_t elapsed = bench_now_ns() - start;
+    // Later repetitions show the steady state, once buffers have grown.
+    allocs = bench_allocations() - allocs_start;
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  char full_name[128];
+  snprintf(full_name, sizeof(full_name), "dispatch/%s", name);
+  bench_report(full_name, ops->len, allocs, 0, best);
+
+  interpreter_free(interpreter);
+  op_buffer_free(ops);
+  symbol_table_free(symbols);
+  string_arena_free(arena);
+  free(script);
+}
+
+void bench_dispatch() {
+  // A builtin and the end of its statement.
+  run("builtins", ":\n");
+  // Builtins with arguments, and jumps which are taken half of the time.
+  run("lists", ": a && false b || true c && : d\n");
+  // A failure which skips a long chain, so that most operations are jumps.
+  run("jumps", "false && : && : && : && : && : && : && :\n");
+}
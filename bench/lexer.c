@@ -0,0 +1,92 @@
+#include "ctype.h"
+#include "stdbool.h"
+#include "stdlib.h"
+#include "string.h"
+
+#include "bench/bench.h"
+#include "include/lexer.h"
+
+/// How many times each benchmark runs, keeping the fastest.
+static const int REPETITIONS = 5;
+
+/// The byte at a time lexer the table driven one replaced.
+///
+/// This is kept as a point of comparison, and only splits words on spaces.
+static void baseline_lexer_next(Lexer *lexer, Token *out) {
+  for (;;) {
+    char next = lexer->index < lexer->len ? lexer->input[lexer->index] : 0;
+    if (next == 0) {
+      out->type = TOKEN_EOF;
+    } else if (next == '>') {
+      out->type = TOKEN_REDIRECT;
+      out->data.redirect.type = REDIRECT_WRITE;
+      out->data.redirect.fd = 1;
+      lexer->index++;
+    } else if (next == '|') {
+      out->type = TOKEN_PIPE;
+      lexer->index++;
+    } else if (isspace(next)) {
+      lexer->index++;
+      continue;
+    } else {
+      size_t start = lexer->index;
+      for (; lexer->index < lexer->len && !isspace(lexer->input[lexer->index]);
+           lexer->index++) {
+      }
+      StringSlice slice = {.data = lexer->input + start,
+                           .len = lexer->index - start};
+      out->type = TOKEN_WORD;
+      out->data.string = string_arena_alloc(lexer->arena, slice);
+    }
+    return;
+  }
+}
+
+static void run(char const *name, StringSlice script, bool baseline) {
+  StringArena *arena = string_arena_init();
+  uint64_t best = UINT64_MAX;
+  uint64_t allocs = 0;
+  uint64_t tokens = 0;
+  for (int rep = 0; rep < REPETITIONS; ++rep) {
+    string_arena_reset(arena);
+    Lexer lexer = lexer_init(script, arena);
+    Token token;
+    tokens = 0;
+    uint64_t allocs_start = bench_allocations();
+    uint64_t start = bench_now_ns();
+    do {
+      if (baseline) {
+        baseline_lexer_next(&lexer, &token);
+      } else if (lexer_next(&lexer, &token).type != ERROR_NONE) {
+        abort();
+      }
+      tokens++;
+    } while (token.type != TOKEN_EOF);
+    uint64_t elapsed = bench_now_ns() - start;
+    // Later repetitions show the steady state, once buffers have grown.
+    allocs = bench_allocations() - allocs_start;
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+  bench_report(name, tokens, allocs, script.len, best);
+  string_arena_free(arena);
+}
+
+void bench_lexer() {
+  StringSlice plain = bench_generate_script(24, false);
+  StringSlice quoted = bench_generate_script(24, true);
+  // Generated commands often have long arguments, like paths or encoded data.
+  StringSlice long_args = bench_generate_script(256, false);
+
+  run("lexer/plain/baseline", plain, true);
+  run("lexer/plain", plain, false);
+  run("lexer/quoted/baseline", quoted, true);
+  run("lexer/quoted", quoted, false);
+  run("lexer/long/baseline", long_args, true);
+  run("lexer/long", long_args, false);
+
+  free((void *)plain.data);
+  free((void *)quoted.data);
+  free((void *)long_args.data);
+}
@@ -0,0 +1,45 @@
+#include "stdio.h"
+#include "string.h"
+
+#include "bench/bench.h"
+
+typedef struct Bench {
+  char const *name;
+  void (*run)();
+} Bench;
+
+static const Bench BENCHES[] = {
+    {"lexer", bench_lexer},
+    {"parser", bench_parser},
+    {"stages", bench_stages},
+    {"dispatch", bench_dispatch},
+};
+
+void bench_report(char const *name, uint64_t ops, uint64_t allocs,
+                  uint64_t bytes, uint64_t elapsed_ns) {
+  double ns_per_op = (double)elapsed_ns / (double)ops;
+  double allocs_per_op = (double)allocs / (double)ops;
+  if (bytes == 0) {
+    printf("%s\t%.1f\t%.3f\t-\n", name, ns_per_op, allocs_per_op);
+  } else {
+    double mb_per_s = ((double)bytes / 1e6) / ((double)elapsed_ns / 1e9);
+    printf("%s\t%.1f\t%.3f\t%.1f\n", name, ns_per_op, allocs_per_op,
+           mb_per_s);
+  }
+  fflush(stdout);
+}
+
+/// Run every benchmark, or only the groups named on the command line.
+int main(int argc, char **argv) {
+  puts("name\tns/op\tallocs/op\tMB/s");
+  for (size_t i = 0; i < sizeof(BENCHES) / sizeof(BENCHES[0]); ++i) {
+    int selected = argc <= 1;
+    for (int j = 1; j < argc; ++j) {
+      selected |= strcmp(argv[j], BENCHES[i].name) == 0;
+    }
+    if (selected) {
+      BENCHES[i].run();
+    }
+  }
+  return 0;
+}
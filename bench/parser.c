@@ -0,0 +1,271 @@
+#include "stdbool.h"
+#include "stdlib.h"
+#include "string.h"
+
+#include "bench/bench.h"
+#include "include/compiler.h"
+#include "include/parser.h"
+
+/// How many times each benchmark runs, keeping the fastest.
+static const int REPETITIONS = 5;
+
+/// Compile a script, either through a tree, or in a single pass.
+static void compile_script(StringSlice script, StringArena *arena,
+                           ASTArena *ast_arena, OpBuffer *ops, bool direct) {
+  string_arena_reset(arena);
+  ast_arena_reset(ast_arena);
+  op_buffer_reset(ops);
+  Lexer lexer = lexer_init(script, arena);
+  Error err;
+  if (direct) {
+    Parser parser = parser_init(&lexer, NULL);
+    err = compile_direct(&parser, ops);
+  } else {
+    Parser parser = parser_init(&lexer, ast_arena);
+    ASTNode node;
+    err = parser_parse(&parser, &node);
+    if (err.type == ERROR_NONE) {
+      err = compile(&node, arena, ops);
+    }
+  }
+  if (err.type != ERROR_NONE) {
+    fprintf(stderr, "parser: %s\n", error_str(err));
+    abort();
+  }
+}
+
+static void run(char const *name, StringSlice script, bool direct) {
+  StringArena *arena = string_arena_init();
+  ASTArena *ast_arena = ast_arena_init();
+  OpBuffer *ops = op_buffer_init();
+  uint64_t best = UINT64_MAX;
+  uint64_t allocs = 0;
+  for (int rep = 0; rep < REPETITIONS; ++rep) {
+    uint64_t allocs_start = bench_allocations();
+    uint64_t start = bench_now_ns();
+    compile_script(script, arena, ast_arena, ops, direct);
+    uint64_t elapsed = bench_now_ns() - start;
+    // Later repetitions show the steady state, once buffers have grown.
+    allocs = bench_allocations() - allocs_start;
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+  bench_report(name, ops->len, allocs, script.len, best);
+  op_buffer_free(ops);
+  ast_arena_free(ast_arena);
+  string_arena_free(arena);
+}
+
+/// Check whether two linked substitutions are the same.
+///
+/// Both programs are linked with the same symbol table, so the same
+/// variables have the same symbols.
+static bool same_part(ExpansionPart const *a, ExpansionPart const *b) {
+  return a->arg == b->arg && a->text_len == b->text_len &&
+         memcmp(a->text.string, b->text.string, a->text_len) == 0 &&
+         a->variable.symbol == b->variable.symbol;
+}
+
+/// Check whether two linked redirects are the same.
+static bool same_redirect(Redirect const *a, Redirect const *b) {
+  if (a->type != b->type || a->fd != b->fd) {
+    return false;
+  }
+  if (a->type == REDIRECT_DUP) {
+    return a->data.source_fd == b->data.source_fd;
+  }
+  if (a->type == REDIRECT_TEMPLATE) {
+    ExpansionTable const *ea = a->data.expansion;
+    ExpansionTable const *eb = b->data.expansion;
+    if (ea->count != eb->count) {
+      return false;
+    }
+    for (size_t i = 0; i < ea->count; ++i) {
+      if (!same_part(ea->parts + i, eb->parts + i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return strcmp(a->data.string, b->data.string) == 0;
+}
+
+/// Check whether two linked commands have the same arguments, redirects,
+/// substitutions, and bindings.
+static bool same_argv(char **a, char **b, OpFlag flag) {
+  size_t arg_count = 0;
+  for (; a[arg_count] != NULL || b[arg_count] != NULL; ++arg_count) {
+    if (a[arg_count] == NULL || b[arg_count] == NULL ||
+        strcmp(a[arg_count], b[arg_count]) != 0) {
+      return false;
+    }
+  }
+  // The count doesn't include the name, which op_redirects expects.
+  if (flag & OP_FLAG_REDIRECT) {
+    RedirectTable const *ra = op_redirects(a, arg_count - 1);
+    RedirectTable const *rb = op_redirects(b, arg_count - 1);
+    if (ra->count != rb->count) {
+      return false;
+    }
+    for (size_t i = 0; i < ra->count; ++i) {
+      if (!same_redirect(ra->redirects + i, rb->redirects + i)) {
+        return false;
+      }
+    }
+  }
+  if (flag & OP_FLAG_EXPAND) {
+    ExpansionTable const *ea = op_expansions(a, arg_count - 1, flag);
+    ExpansionTable const *eb = op_expansions(b, arg_count - 1, flag);
+    if (ea->count != eb->count) {
+      return false;
+    }
+    for (size_t i = 0; i < ea->count; ++i) {
+      if (!same_part(ea->parts + i, eb->parts + i)) {
+        return false;
+      }
+    }
+  }
+  if (flag & OP_FLAG_OVERLAY) {
+    OverlayTable const *oa = op_overlay(a, arg_count - 1, flag);
+    OverlayTable const *ob = op_overlay(b, arg_count - 1, flag);
+    char **ba = op_bindings(a, arg_count - 1, flag);
+    char **bb = op_bindings(b, arg_count - 1, flag);
+    if (oa->count != ob->count) {
+      return false;
+    }
+    for (size_t i = 0; i < oa->count; ++i) {
+      if (oa->symbols[i] != ob->symbols[i] || strcmp(ba[i], bb[i]) != 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// Make sure both front ends agree, so that we're comparing like with like.
+///
+/// The arguments of each command end up in different places in the arena,
+/// so they're compared once linked.
+static void check_same(StringSlice script) {
+  StringArena *tree_arena = string_arena_init();
+  StringArena *direct_arena = string_arena_init();
+  ASTArena *ast_arena = ast_arena_init();
+  OpBuffer *tree = op_buffer_init();
+  OpBuffer *direct = op_buffer_init();
+  SymbolTable *symbols = symbol_table_init();
+  compile_script(script, tree_arena, ast_arena, tree, false);
+  compile_script(script, direct_arena, ast_arena, direct, true);
+  op_buffer_link(tree, tree_arena, symbols);
+  op_buffer_link(direct, direct_arena, symbols);
+  if (tree->len != direct->len) {
+    fprintf(stderr, "parser: front ends emit %zu and %zu operations\n",
+            tree->len, direct->len);
+    abort();
+  }
+  for (size_t i = 0; i < tree->len; ++i) {
+    Op a = tree->ops[i];
+    Op b = direct->ops[i];
+    bool same = a.type == b.type && a.flag == b.flag;
+    if (same && op_is_command(a.type)) {
+      same = same_argv(string_arena_get_argv(tree_arena, a.data.command.argv),
+                       string_arena_get_argv(direct_arena,
+                                             b.data.command.argv),
+                       a.flag);
+    }
+    if (same && op_is_builtin(a.type)) {
+      same = a.data.builtin.builtin == b.data.builtin.builtin &&
+             same_argv(string_arena_get_argv(tree_arena, a.data.builtin.argv),
+                       string_arena_get_argv(direct_arena,
+                                             b.data.builtin.argv),
+                       a.flag);
+    }
+    if (same && a.type == OP_ASSIGN) {
+      Variable const *va =
+          string_arena_get_data(tree_arena, a.data.assign.variable);
+      Variable const *vb =
+          string_arena_get_data(direct_arena, b.data.assign.variable);
+      same = va->symbol == vb->symbol &&
+             same_argv(string_arena_get_argv(tree_arena, a.data.assign.argv),
+                       string_arena_get_argv(direct_arena,
+                                             b.data.assign.argv),
+                       a.flag);
+    }
+    if (same &&
+        (a.type == OP_JUMP_IF_SUCCESS || a.type == OP_JUMP_IF_FAILURE)) {
+      same = a.data.target == b.data.target;
+    }
+    if (!same) {
+      fprintf(stderr, "parser: front ends differ at operation %zu\n", i);
+      abort();
+    }
+  }
+  if (tree->len != direct->len) {
+    fprintf(stderr, "parser: front ends differ in length\n");
+    abort();
+  }
+  op_buffer_free(direct);
+  op_buffer_free(tree);
+  symbol_table_free(symbols);
+  ast_arena_free(ast_arena);
+  string_arena_free(direct_arena);
+  string_arena_free(tree_arena);
+}
+
+/// Make sure a here-document is only expanded when its delimiter isn't
+/// quoted, and that a here-string always is, with both front ends.
+static void check_here_docs() {
+  static const struct {
+    char const *script;
+    RedirectType type;
+  } cases[] = {
+      {"cat <<EOF\n$X\nEOF\n", REDIRECT_TEMPLATE},
+      {"cat <<'EOF'\n$X\nEOF\n", REDIRECT_STRING},
+      {"cat <<\\EOF\n$X\nEOF\n", REDIRECT_STRING},
+      {"cat <<EOF\n\\$X\nEOF\n", REDIRECT_STRING},
+      {"cat <<< \"$X\"\n", REDIRECT_TEMPLATE},
+      {"cat <<< '$X'\n", REDIRECT_STRING},
+  };
+  StringArena *arena = string_arena_init();
+  ASTArena *ast_arena = ast_arena_init();
+  OpBuffer *ops = op_buffer_init();
+  SymbolTable *symbols = symbol_table_init();
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    StringSlice script = {.data = cases[i].script,
+                          .len = strlen(cases[i].script)};
+    check_same(script);
+    compile_script(script, arena, ast_arena, ops, true);
+    op_buffer_link(ops, arena, symbols);
+    Op op = ops->ops[0];
+    char **argv = string_arena_get_argv(arena, op.data.command.argv);
+    Redirect const *r =
+        op_redirects(argv, op.data.command.arg_count)->redirects;
+    bool literal = r->type == REDIRECT_STRING &&
+                   strcmp(r->data.string, "$X\n") == 0;
+    if (r->type != cases[i].type ||
+        (r->type == REDIRECT_STRING && !literal)) {
+      fprintf(stderr, "parser: wrong here-document for %s", cases[i].script);
+      abort();
+    }
+  }
+  symbol_table_free(symbols);
+  op_buffer_free(ops);
+  ast_arena_free(ast_arena);
+  string_arena_free(arena);
+}
+
+void bench_parser() {
+  StringSlice plain = bench_generate_script(24, false);
+  StringSlice quoted = bench_generate_script(24, true);
+  check_same(plain);
+  check_same(quoted);
+  check_here_docs();
+
+  run("parser/plain/tree", plain, false);
+  run("parser/plain/direct", plain, true);
+  run("parser/quoted/tree", quoted, false);
+  run("parser/quoted/direct", quoted, true);
+
+  free((void *)plain.data);
+  free((void *)quoted.data);
+}
@@ -0,0 +1,82 @@
+#include "stdlib.h"
+#include "string.h"
+
+#include "bench/bench.h"
+
+/// How many bytes of script each generated script has, roughly.
+static const size_t SCRIPT_SIZE = 8 << 20;
+
+static uint64_t rng_state;
+
+/// A small xorshift generator, so that runs use the same inputs.
+static uint64_t rng_next() {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static size_t append_word(char *out, size_t at, size_t max_len) {
+  static char const chars[] = "abcdefghijklmnopqrstuvwxyz0123456789-_./=";
+  size_t len = 1 + rng_next() % max_len;
+  for (size_t i = 0; i < len; ++i) {
+    out[at + i] = chars[rng_next() % (sizeof(chars) - 1)];
+  }
+  return at + len;
+}
+
+StringSlice bench_generate_script(size_t arg_len, bool quoted) {
+  rng_state = 0x9e3779b97f4a7c15;
+  char *out = malloc(SCRIPT_SIZE + 20 * arg_len + 64);
+  size_t at = 0;
+  for (bool piped = false; at < SCRIPT_SIZE || piped;) {
+    size_t name = at;
+    at = append_word(out, at, 12);
+    // A name like `a=b` would be an assignment, not a command.
+    for (size_t i = name; i < at; ++i) {
+      if (out[i] == '=') {
+        out[i] = '-';
+      }
+    }
+    size_t args = rng_next() % 8;
+    for (size_t i = 0; i < args; ++i) {
+      out[at++] = ' ';
+      uint64_t kind = quoted ? rng_next() % 4 : 0;
+      if (kind == 1) {
+        out[at++] = '\'';
+        at = append_word(out, at, arg_len);
+        out[at++] = ' ';
+        at = append_word(out, at, arg_len);
+        out[at++] = '\'';
+      } else if (kind == 2) {
+        out[at++] = '"';
+        at = append_word(out, at, arg_len);
+        out[at++] = '\\';
+        out[at++] = '"';
+        out[at++] = '"';
+      } else {
+        at = append_word(out, at, arg_len);
+      }
+    }
+    // Only end a pipeline past the end, so the script stays valid.
+    piped = false;
+    switch (rng_next() % 4) {
+    case 0: {
+      if (at < SCRIPT_SIZE) {
+        memcpy(out + at, " | ", 3);
+        at += 3;
+        piped = true;
+        continue;
+      }
+      break;
+    }
+    case 1: {
+      memcpy(out + at, " > ", 3);
+      at = append_word(out, at + 3, 16);
+      break;
+    }
+    }
+    out[at++] = '\n';
+  }
+  return (StringSlice){.data = out, .len = at};
+}
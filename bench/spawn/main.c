@@ -0,0 +1,267 @@
+#include "errno.h"
+#include "fcntl.h"
+#include "spawn.h"
+#include "stdint.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/resource.h"
+#include "sys/wait.h"
+#include "time.h"
+#include "unistd.h"
+
+#include "bench/bench.h"
+
+/// Runs scripted workloads through whole shells, comparing sally with others.
+///
+/// Each workload is a script repeating the same statement. The script is run
+/// as a separate batch a number of times, and each batch is timed as a whole.
+/// Dividing by the number of commands in a batch gives the latency of each
+/// command, including the share of starting the shell.
+
+extern char **environ;
+
+/// How many times each workload runs, with a fresh shell each time.
+static const int BATCHES = 20;
+
+typedef struct Workload {
+  char const *name;
+  /// The statement repeated throughout the script.
+  char const *statement;
+  /// How many times the statement is repeated in each batch.
+  size_t repeat;
+  /// How many commands each statement runs.
+  size_t commands;
+} Workload;
+
+static char redirect_statement[256];
+
+static Workload WORKLOADS[] = {
+    {"true", "/bin/true\n", 200, 1},
+    {"pipeline", "echo x | cat | cat | cat | cat | cat | cat | cat\n", 25, 8},
+    {"redirect", redirect_statement, 200, 1},
+    {"builtin", "echo x\n", 5000, 1},
+};
+
+/// The size of the file streamed through pipelines by `stream`.
+static const size_t STREAM_BYTES = 32 << 20;
+
+static char stream_statement[256];
+
+/// Streams a file through a pipeline of `cat`s, measuring throughput.
+///
+/// This runs at the default pipe size, and at each of the sizes given to
+/// sally through `SALLY_PIPE_SIZE`.
+static Workload STREAM = {"stream", stream_statement, 4, 4};
+
+static char const *const PIPE_SIZES[] = {"256k", "1m"};
+
+/// Write a workload into a temporary script, returning its path.
+static char *write_script(Workload *workload) {
+  char *path = strdup("/tmp/sally-spawn-bench-XXXXXX");
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    perror("mkstemp");
+    exit(1);
+  }
+  FILE *out = fdopen(fd, "w");
+  for (size_t i = 0; i < workload->repeat; ++i) {
+    fputs(workload->statement, out);
+  }
+  fclose(out);
+  return path;
+}
+
+typedef struct BatchResult {
+  uint64_t elapsed_ns;
+  /// The peak resident memory of the shell, in KiB.
+  long max_rss;
+} BatchResult;
+
+/// Run a script through a shell once, with its output thrown away.
+static int run_batch(char const *shell, char const *script, BatchResult *out) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+                                   O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  char *argv[] = {(char *)shell, (char *)script, NULL};
+
+  uint64_t start = bench_now_ns();
+  pid_t pid;
+  int err = posix_spawn(&pid, shell, &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0) {
+    fprintf(stderr, "%s: %s\n", shell, strerror(err));
+    return -1;
+  }
+  int status;
+  struct rusage usage;
+  while (wait4(pid, &status, 0, &usage) == -1) {
+    if (errno != EINTR) {
+      perror("wait4");
+      return -1;
+    }
+  }
+  out->elapsed_ns = bench_now_ns() - start;
+  out->max_rss = usage.ru_maxrss;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s: %s failed\n", shell, script);
+    return -1;
+  }
+  return 0;
+}
+
+static int compare_u64(void const *a, void const *b) {
+  uint64_t x = *(uint64_t const *)a;
+  uint64_t y = *(uint64_t const *)b;
+  return (x > y) - (x < y);
+}
+
+/// Run every batch of a workload, filling in the time each one took, and
+/// returning how many batches succeeded.
+static int run_batches(char const *shell, Workload *workload,
+                       uint64_t elapsed[BATCHES], long *max_rss_out) {
+  char *script = write_script(workload);
+  int batches = 0;
+  *max_rss_out = 0;
+  for (; batches < BATCHES; ++batches) {
+    BatchResult result;
+    if (run_batch(shell, script, &result) == -1) {
+      break;
+    }
+    elapsed[batches] = result.elapsed_ns;
+    if (result.max_rss > *max_rss_out) {
+      *max_rss_out = result.max_rss;
+    }
+  }
+  unlink(script);
+  free(script);
+  return batches;
+}
+
+static void run(char const *shell_name, char const *shell,
+                Workload *workload) {
+  uint64_t commands = workload->repeat * workload->commands;
+  uint64_t latencies[BATCHES];
+  long max_rss;
+  int batches = run_batches(shell, workload, latencies, &max_rss);
+  if (batches == 0) {
+    return;
+  }
+  uint64_t total_ns = 0;
+  for (int i = 0; i < batches; ++i) {
+    total_ns += latencies[i];
+    latencies[i] /= commands;
+  }
+
+  qsort(latencies, batches, sizeof(uint64_t), compare_u64);
+  double rate = (double)(commands * batches) / ((double)total_ns / 1e9);
+  printf("%s/%s\t%.0f\t%.1f\t%.1f\t%ld\n", workload->name, shell_name, rate,
+         latencies[batches / 2] / 1e3, latencies[(batches * 99) / 100] / 1e3,
+         max_rss);
+  fflush(stdout);
+}
+
+/// Run the stream workload, reporting how much data went through each pipe.
+static void run_stream(char const *name, char const *shell) {
+  uint64_t elapsed[BATCHES];
+  long max_rss;
+  int batches = run_batches(shell, &STREAM, elapsed, &max_rss);
+  if (batches == 0) {
+    return;
+  }
+  qsort(elapsed, batches, sizeof(uint64_t), compare_u64);
+  // Each byte goes through every pipe of the pipeline.
+  double bytes = (double)(STREAM_BYTES * STREAM.repeat * (STREAM.commands - 1));
+  printf("%s\t%.0f\t%.1f\t%.1f\t%ld\n", name,
+         bytes / ((double)elapsed[batches / 2] / 1e9) / (1 << 20),
+         elapsed[batches / 2] / 1e6, elapsed[(batches * 99) / 100] / 1e6,
+         max_rss);
+  fflush(stdout);
+}
+
+/// Write the file the stream workload reads.
+static int write_stream_file(char const *path) {
+  FILE *out = fopen(path, "w");
+  if (out == NULL) {
+    perror(path);
+    return -1;
+  }
+  char chunk[1 << 16];
+  for (size_t i = 0; i < sizeof(chunk); ++i) {
+    chunk[i] = 'a' + i % 26;
+  }
+  for (size_t done = 0; done < STREAM_BYTES; done += sizeof(chunk)) {
+    fwrite(chunk, 1, sizeof(chunk), out);
+  }
+  return fclose(out);
+}
+
+/// Run every workload through sally, and through /bin/sh if it exists.
+///
+/// Other shells can be compared against by passing their paths.
+int main(int argc, char **argv) {
+  char redirect_file[] = "/tmp/sally-spawn-bench-out-XXXXXX";
+  int fd = mkstemp(redirect_file);
+  if (fd == -1) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+  snprintf(redirect_statement, sizeof(redirect_statement),
+           "/bin/echo x > %s\n", redirect_file);
+
+  char const *shells[16] = {SALLY_EXECUTABLE};
+  int shell_count = 1;
+  if (argc > 1) {
+    for (int i = 1; i < argc && shell_count < 16; ++i) {
+      shells[shell_count++] = argv[i];
+    }
+  } else if (access("/bin/sh", X_OK) == 0) {
+    shells[shell_count++] = "/bin/sh";
+  }
+
+  puts("name\tcmds/s\tp50_us\tp99_us\tmaxrss_kb");
+  for (size_t i = 0; i < sizeof(WORKLOADS) / sizeof(WORKLOADS[0]); ++i) {
+    for (int j = 0; j < shell_count; ++j) {
+      char const *name = strrchr(shells[j], '/');
+      run(name == NULL ? shells[j] : name + 1, shells[j], WORKLOADS + i);
+    }
+  }
+
+  // The file is written before anything is timed, so it's in the page cache.
+  char stream_file[] = "/tmp/sally-spawn-bench-stream-XXXXXX";
+  fd = mkstemp(stream_file);
+  if (fd == -1) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+  if (write_stream_file(stream_file) != 0) {
+    return 1;
+  }
+  snprintf(stream_statement, sizeof(stream_statement),
+           "cat %s | cat | cat | cat > /dev/null\n", stream_file);
+
+  puts("\nname\tMB/s\tp50_ms\tp99_ms\tmaxrss_kb");
+  for (int j = 0; j < shell_count; ++j) {
+    char const *name = strrchr(shells[j], '/');
+    name = name == NULL ? shells[j] : name + 1;
+    char row[64];
+    snprintf(row, sizeof(row), "stream/%s", name);
+    run_stream(row, shells[j]);
+  }
+  for (size_t i = 0; i < sizeof(PIPE_SIZES) / sizeof(PIPE_SIZES[0]); ++i) {
+    setenv("SALLY_PIPE_SIZE", PIPE_SIZES[i], 1);
+    char row[64];
+    snprintf(row, sizeof(row), "stream-%s/sally", PIPE_SIZES[i]);
+    run_stream(row, SALLY_EXECUTABLE);
+  }
+  unsetenv("SALLY_PIPE_SIZE");
+
+  unlink(redirect_file);
+  unlink(stream_file);
+  return 0;
+}
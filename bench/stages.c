@@ -0,0 +1,196 @@
+#include "stdlib.h"
+#include "string.h"
+
+#include "bench/bench.h"
+#include "include/compiler.h"
+#include "include/interpreter.h"
+#include "include/parser.h"
+
+/// How many bytes of script each workload has, roughly.
+static const size_t WORKLOAD_SIZE = 1 << 20;
+
+/// How many times each benchmark runs, keeping the fastest.
+static const int REPETITIONS = 5;
+
+/// A script stressing one part of the syntax.
+///
+/// Every command is the `:` builtin, so that the interpreter can run the
+/// whole script without starting any processes.
+typedef struct Workload {
+  char const *name;
+  StringSlice script;
+  /// The number of statements in the script.
+  uint64_t statements;
+} Workload;
+
+/// Generate a workload, made of the same statement repeated.
+static Workload generate_workload(char const *name, char const *statement) {
+  size_t len = strlen(statement);
+  size_t count = WORKLOAD_SIZE / len + 1;
+  char *out = malloc(count * len);
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(out + i * len, statement, len);
+  }
+  return (Workload){.name = name,
+                    .script = {.data = out, .len = count * len},
+                    .statements = count};
+}
+
+/// Build a statement out of a repeated piece, between a head and a tail.
+static char *repeat(char const *head, char const *piece, size_t count,
+                    char const *tail) {
+  size_t head_len = strlen(head);
+  size_t piece_len = strlen(piece);
+  size_t tail_len = strlen(tail);
+  char *out = malloc(head_len + count * piece_len + tail_len + 1);
+  memcpy(out, head, head_len);
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(out + head_len + i * piece_len, piece, piece_len);
+  }
+  memcpy(out + head_len + count * piece_len, tail, tail_len + 1);
+  return out;
+}
+
+typedef enum Stage {
+  STAGE_LEXER,
+  STAGE_PARSER,
+  STAGE_COMPILE,
+  STAGE_DIRECT,
+  STAGE_INTERPRETER,
+} Stage;
+
+static char const *const STAGE_NAMES[] = {
+    [STAGE_LEXER] = "lexer",
+    [STAGE_PARSER] = "parser",
+    [STAGE_COMPILE] = "compile",
+    [STAGE_DIRECT] = "direct",
+    [STAGE_INTERPRETER] = "interpreter",
+};
+
+static void check(Error err) {
+  if (err.type != ERROR_NONE) {
+    fprintf(stderr, "stages: %s\n", error_str(err));
+    abort();
+  }
+}
+
+/// Everything the stages need, allocated once per benchmark.
+typedef struct StageState {
+  StringArena *arena;
+  SymbolTable *symbols;
+  ASTArena *ast_arena;
+  OpBuffer *ops;
+  Interpreter *interpreter;
+  ASTNode tree;
+} StageState;
+
+/// Prepare the input of a stage, which isn't timed.
+static void stage_prepare(Stage stage, Workload *workload, StageState *state) {
+  string_arena_reset(state->arena);
+  ast_arena_reset(state->ast_arena);
+  op_buffer_reset(state->ops);
+  if (stage == STAGE_COMPILE || stage == STAGE_INTERPRETER) {
+    Lexer lexer = lexer_init(workload->script, state->arena);
+    Parser parser = parser_init(&lexer, state->ast_arena);
+    check(parser_parse(&parser, &state->tree));
+  }
+  if (stage == STAGE_INTERPRETER) {
+    check(compile(&state->tree, state->arena, state->ops));
+    op_buffer_link(state->ops, state->arena, state->symbols);
+    interpreter_reset(state->interpreter);
+  }
+}
+
+static void stage_run(Stage stage, Workload *workload, StageState *state) {
+  switch (stage) {
+  case STAGE_LEXER: {
+    Lexer lexer = lexer_init(workload->script, state->arena);
+    Token token;
+    do {
+      check(lexer_next(&lexer, &token));
+    } while (token.type != TOKEN_EOF);
+    break;
+  }
+  case STAGE_PARSER: {
+    Lexer lexer = lexer_init(workload->script, state->arena);
+    Parser parser = parser_init(&lexer, state->ast_arena);
+    check(parser_parse(&parser, &state->tree));
+    break;
+  }
+  case STAGE_COMPILE: {
+    check(compile(&state->tree, state->arena, state->ops));
+    break;
+  }
+  case STAGE_DIRECT: {
+    Lexer lexer = lexer_init(workload->script, state->arena);
+    Parser parser = parser_init(&lexer, NULL);
+    check(compile_direct(&parser, state->ops));
+    break;
+  }
+  case STAGE_INTERPRETER: {
+    check(interpreter_run(state->interpreter, state->ops));
+    break;
+  }
+  }
+}
+
+static void run(Workload *workload, Stage stage) {
+  StageState state;
+  state.arena = string_arena_init();
+  state.symbols = symbol_table_init();
+  state.ast_arena = ast_arena_init();
+  state.ops = op_buffer_init();
+  state.interpreter = interpreter_init(state.arena, state.symbols);
+
+  uint64_t best = UINT64_MAX;
+  uint64_t allocs = 0;
+  for (int rep = 0; rep < REPETITIONS; ++rep) {
+    stage_prepare(stage, workload, &state);
+    uint64_t allocs_start = bench_allocations();
+    uint64_t start = bench_now_ns();
+    stage_run(stage, workload, &state);
+    uint64_t elapsed = bench_now_ns() - start;
+    // Later repetitions show the steady state, once buffers have grown.
+    allocs = bench_allocations() - allocs_start;
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  char name[128];
+  snprintf(name, sizeof(name), "stages/%s/%s", workload->name,
+           STAGE_NAMES[stage]);
+  bench_report(name, workload->statements, allocs, workload->script.len,
+               best);
+
+  interpreter_free(state.interpreter);
+  op_buffer_free(state.ops);
+  ast_arena_free(state.ast_arena);
+  symbol_table_free(state.symbols);
+  string_arena_free(state.arena);
+}
+
+void bench_stages() {
+  char *args = repeat(":", " argument", 256, "\n");
+  char *pipes = repeat(":", " x | :", 31, " x\n");
+  char *redirects = repeat("", ": a b c > /dev/null\n", 1, "");
+  char *variables = repeat("X=/some/value; :", " $X \"${X}/a\"", 32, "\n");
+  Workload workloads[] = {
+      generate_workload("args", args),
+      generate_workload("pipes", pipes),
+      generate_workload("redirects", redirects),
+      generate_workload("variables", variables),
+  };
+  size_t count = sizeof(workloads) / sizeof(workloads[0]);
+
+  for (size_t i = 0; i < count; ++i) {
+    for (Stage stage = STAGE_LEXER; stage <= STAGE_INTERPRETER; ++stage) {
+      run(workloads + i, stage);
+    }
+    free((void *)workloads[i].script.data);
+  }
+  free(args);
+  free(pipes);
+  free(redirects);
+  free(variables);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "stddef.h"
+#include "stdint.h"
+
+#include "include/builtin.h"
+#include "include/redirect.h"
+#include "include/string_arena.h"
+
+/// Represents one of the variants in our AST.
+typedef enum ASTType {
+  /// Represents a builtin command for our shell.
+  AST_BUILTIN,
+  /// Represents an arbitrary command that isn't builtin.
+  ///
+  /// If the name of the command contains substitutions, its string is
+  /// `STRING_HANDLE_NULL`, and the name is the first child instead.
+  AST_COMMAND,
+  /// Represent an individual argument for some command.
+  AST_ARG,
+  /// Represents an argument containing substitutions, whose string is a
+  /// template, as described for `TOKEN_EXPANSION`.
+  AST_EXPANSION,
+  /// Represents a command made only of assignments, each one a child.
+  AST_ASSIGN,
+  /// Represents a command run with variables overridden in its environment,
+  /// like `A=1 cmd`.
+  ///
+  /// The last child is the command, and each child before it an
+  /// `AST_VARIABLE`.
+  AST_OVERLAY,
+  /// Represents assigning to a single variable, under an `AST_ASSIGN` or an
+  /// `AST_OVERLAY`.
+  ///
+  /// The string is the name of the variable, and the only child is its value,
+  /// either an `AST_ARG` or an `AST_EXPANSION`.
+  AST_VARIABLE,
+  /// Represents a command with its input or output redirected.
+  ///
+  /// The first child is the command, and each child after it is one of its
+  /// redirects, in the order they're applied.
+  AST_REDIRECT,
+  /// Represents a single redirect, under an `AST_REDIRECT`.
+  AST_REDIRECTION,
+  /// Represents the piping between two processes.
+  AST_PIPE,
+  /// Represents a list of statements, run one after the other.
+  AST_SEQUENCE,
+  /// Represents a statement running in the background, without waiting.
+  AST_BACKGROUND,
+  /// Represents running a second statement only if the first one succeeds.
+  AST_AND,
+  /// Represents running a second statement only if the first one fails.
+  AST_OR
+} ASTType;
+
+/// Represents one of the nodes in our AST.
+typedef struct ASTNode ASTNode;
+
+/// Represents one of the kinds of data our AST can handle.
+typedef union ASTData {
+  /// The string for commands and arguments.
+  StringHandle string;
+  /// The builtin for builtin commands.
+  Builtin builtin;
+  /// The redirect, with its file, for redirections.
+  Redirect redirect;
+} ASTData;
+
+struct ASTNode {
+  /// The variant this node is.
+  ASTType type;
+  /// The number of children under this node, if relevant.
+  uint32_t count;
+  /// The children beneath this node, if any, living in an `ASTArena`.
+  ASTNode *children;
+  /// Additional data associated with this node.
+  ASTData data;
+};
+
+/// An arena holding the nodes of syntax trees.
+///
+/// Nodes are bump allocated, and all freed at once when the arena is reset,
+/// so that parsing doesn't need to allocate once the arena has warmed up.
+typedef struct ASTArena ASTArena;
+
+/// Initialize an AST arena.
+///
+/// The result should be freed with `ast_arena_free`.
+ASTArena *ast_arena_init();
+
+/// Free every node in the arena, keeping its memory around for reuse.
+void ast_arena_reset(ASTArena *arena);
+
+/// Free the memory of an arena, including the arena itself.
+void ast_arena_free(ASTArena *arena);
+
+/// Push a node onto the scratch stack of the arena.
+///
+/// The children of a node are gathered on this stack while they're parsed,
+/// and then moved into the arena all at once with `ast_arena_commit`.
+void ast_arena_push(ASTArena *arena, ASTNode node);
+
+/// The number of nodes on the scratch stack.
+size_t ast_arena_mark(ASTArena *arena);
+
+/// Remove the last node pushed onto the scratch stack, returning it.
+ASTNode ast_arena_pop(ASTArena *arena);
+
+/// Move every node pushed since a mark into the arena.
+///
+/// Parsing can fail halfway, leaving nodes on the stack, which get cleared
+/// when the arena is reset.
+///
+/// The nodes are contiguous, with the returned pointer staying valid until
+/// the arena is reset. Nothing gets allocated if no nodes were pushed.
+ASTNode *ast_arena_commit(ASTArena *arena, size_t mark);
@@ -1,9 +1,81 @@
 #pragma once
 
+#include "stdbool.h"
+#include "stdio.h"
+
+#include "include/string_arena.h"
+
 /// Represents all of the builtin commands we have
 typedef enum Builtin {
   // A builtin which prints the current directory
   BUILTIN_PWD,
   // A builtin command which changes the current directory
-  BUILTIN_CD
+  BUILTIN_CD,
+  // A builtin which inspects or clears the cache of command locations
+  BUILTIN_HASH,
+  // A builtin which prints its arguments
+  BUILTIN_ECHO,
+  // A builtin which prints its arguments, according to a format
+  BUILTIN_PRINTF,
+  // A builtin which evaluates a condition
+  BUILTIN_TEST,
+  // The same as test, but expecting a closing `]`
+  BUILTIN_BRACKET,
+  // A builtin which always succeeds
+  BUILTIN_TRUE,
+  // A builtin which always fails
+  BUILTIN_FALSE,
+  // A builtin which does nothing, and succeeds
+  BUILTIN_COLON,
+  // A builtin which prints the exit status of each stage of the last pipeline
+  BUILTIN_PIPESTATUS,
+  // A builtin which prints how long each stage of running commands takes
+  BUILTIN_STATS,
+  // A builtin which lists the jobs running in the background
+  BUILTIN_JOBS,
+  // A builtin which waits for jobs running in the background
+  BUILTIN_WAIT,
+  // A builtin which runs a command once per input, many at a time
+  BUILTIN_PARALLEL,
+  // A builtin which passes variables on to the commands the shell runs
+  BUILTIN_EXPORT,
+  // A builtin which removes variables
+  BUILTIN_UNSET,
+  // Not a builtin, but the number of builtins
+  BUILTIN_COUNT
 } Builtin;
+
+struct Interpreter;
+
+/// The environment a builtin runs in.
+typedef struct BuiltinEnv {
+  /// The interpreter running this builtin.
+  struct Interpreter *interpreter;
+  /// Where the builtin should write its output, and its errors.
+  FILE *out;
+  FILE *err;
+  /// The descriptor the builtin can read its input from, or -1 if it has none.
+  ///
+  /// This belongs to the interpreter, which closes it when the builtin is done.
+  int in;
+} BuiltinEnv;
+
+/// The implementation of a builtin.
+///
+/// The arguments are null terminated, starting with the name of the builtin.
+/// The result is the exit status, with errors printed to `err` directly.
+typedef int (*BuiltinFn)(BuiltinEnv *env, char **argv);
+
+/// Describes a single builtin.
+typedef struct BuiltinSpec {
+  char const *name;
+  BuiltinFn run;
+} BuiltinSpec;
+
+/// Find which builtin a word refers to, if any.
+///
+/// This uses a perfect hash of the name, so at most one comparison is made.
+bool builtin_lookup(StringSlice name, Builtin *out);
+
+/// Get the description of a builtin.
+BuiltinSpec const *builtin_spec(Builtin builtin);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+
+#include "include/compiler.h"
+#include "include/error.h"
+#include "include/script.h"
+#include "include/string_arena.h"
+
+/// A compiled script, loaded from the on-disk bytecode cache.
+///
+/// Compiled scripts are stored as a header, followed by the raw array of
+/// operations, and then the contents of the string arena they refer to.
+/// Entries are keyed by the path of the script, and are only used if the
+/// modification time, size, and hash of the script still match.
+///
+/// By default, entries live in `$XDG_CACHE_HOME/sally`, falling back to
+/// `$HOME/.cache/sally`. Setting `SALLY_BYTECODE_CACHE=0` disables the cache.
+typedef struct BytecodeCacheEntry {
+  /// The mapped file backing this entry.
+  void *map;
+  size_t map_len;
+  /// The operations of the program, pointing directly into the mapped file.
+  OpBuffer ops;
+} BytecodeCacheEntry;
+
+/// Check whether the cache should be used at all.
+bool bytecode_cache_enabled();
+
+/// Try and load the compiled version of a script.
+///
+/// If a valid entry is found, its strings are loaded into the arena, and true
+/// is returned. The entry should then be released with `bytecode_cache_close`.
+bool bytecode_cache_load(char const *path, Script *script, StringArena *arena,
+                         BytecodeCacheEntry *out);
+
+/// Release the memory of an entry loaded from the cache.
+void bytecode_cache_close(BytecodeCacheEntry *entry);
+
+/// Save the compiled version of a script to the cache.
+///
+/// The arena should contain exactly the strings used by the operations.
+Error bytecode_cache_store(char const *path, Script *script, StringArena *arena,
+                           OpBuffer *ops);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "stddef.h"
+#include "stdio.h"
+
+/// A cache remembering where in `$PATH` each command was found.
+///
+/// Without this, every command would have the C library walk each entry
+/// of `$PATH`, making a failing `execve` for each directory that doesn't
+/// contain the program. Instead, we resolve each name once to an absolute
+/// path, and then execute that path directly.
+///
+/// The cache is emptied whenever the path changes, which the shell sets
+/// whenever `$PATH` is assigned to, rather than reading it each time.
+typedef struct CommandCache CommandCache;
+
+/// Allocate a new, empty command cache.
+///
+/// Commands are searched for in a default path, until one is set with
+/// `command_cache_set_path`. The result should be freed with
+/// `command_cache_free`.
+CommandCache *command_cache_init();
+
+/// Set the path commands are searched for in, like the value of `$PATH`.
+///
+/// NULL means the default path. The cache is emptied if the path changed,
+/// like with `command_cache_clear`.
+void command_cache_set_path(CommandCache *cache, char const *path);
+
+/// Free the memory of a command cache, including the pointer itself.
+void command_cache_free(CommandCache *cache);
+
+/// Find the path a command should be executed from.
+///
+/// Names containing a `/` are returned as is, without being cached. Otherwise,
+/// the name is searched for in the path, unless it was already found before.
+///
+/// NULL is returned if the command can't be found.
+///
+/// The string returned is valid until the cache is next modified.
+char const *command_cache_lookup(CommandCache *cache, char const *name);
+
+/// Remove a single command from the cache.
+///
+/// This should be used when executing a cached path fails with `ENOENT`.
+void command_cache_forget(CommandCache *cache, char const *name);
+
+/// Remove every command from the cache, and reset the hit and miss counters.
+void command_cache_clear(CommandCache *cache);
+
+/// Print the contents of the cache, along with hit and miss counters.
+void command_cache_print(CommandCache *cache, FILE *out);
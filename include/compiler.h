@@ -1,9 +1,15 @@
 #pragma once
 
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
 #include "include/builtin.h"
 #include "include/error.h"
 #include "include/parser.h"
+#include "include/redirect.h"
 #include "include/string_arena.h"
+#include "include/symbol_table.h"
 
 /// The different kinds of operations in our bytecode.
 typedef enum OpType {
@@ -11,37 +17,187 @@ typedef enum OpType {
   OP_BUILTIN,
   /// A custom command.
   OP_COMMAND,
-  /// Push a string onto the stack
-  OP_STRING,
+  /// Wait for every process launched so far to finish.
+  ///
+  /// This marks the end of each statement.
+  OP_WAIT,
+  /// End a statement without waiting for it.
+  ///
+  /// The processes launched by the statement become a background job.
+  OP_BACKGROUND,
+  /// Jump to another operation if the last statement succeeded.
+  OP_JUMP_IF_SUCCESS,
+  /// Jump to another operation if the last statement failed.
+  OP_JUMP_IF_FAILURE,
+  /// A builtin with no flags, outside of any pipeline or redirect.
+  ///
+  /// This is most builtins, and running them needs none of the setup of
+  /// OP_BUILTIN, so the interpreter gives them their own handler.
+  OP_BUILTIN_PLAIN,
+  /// A command with no flags, outside of any pipeline or redirect.
+  OP_COMMAND_PLAIN,
+  /// Assign a value to a variable.
+  OP_ASSIGN,
 } OpType;
 
+/// Whether an operation runs a builtin, with or without flags.
+inline bool op_is_builtin(OpType type) {
+  return type == OP_BUILTIN || type == OP_BUILTIN_PLAIN;
+}
+
+/// Whether an operation runs a command, with or without flags.
+inline bool op_is_command(OpType type) {
+  return type == OP_COMMAND || type == OP_COMMAND_PLAIN;
+}
+
 /// Represents extra flags for some kind of command operation.
 ///
 /// Not always relevant for each operation.
 typedef enum OpFlag {
   OP_FLAG_NONE = 0,
+  /// The command has redirects, in a table right after the NULL ending its
+  /// argv.
   OP_FLAG_REDIRECT = 1,
   OP_FLAG_START_PIPE = 2,
-  OP_FLAG_CONTINUE_PIPE = 4
+  OP_FLAG_CONTINUE_PIPE = 4,
+  /// Some words of the command contain substitutions, in a table after the
+  /// NULL ending its argv, and after its redirects, if any.
+  OP_FLAG_EXPAND = 8,
+  /// The command runs with variables overridden in its environment, like
+  /// `A=1 cmd`, with an `OverlayTable` as the last of its tables.
+  OP_FLAG_OVERLAY = 16
 } OpFlag;
 
+/// The number of tables after the NULL ending the argv of a command.
+inline size_t op_table_count(OpFlag flag) {
+  return ((flag & OP_FLAG_REDIRECT) ? 1 : 0) +
+         ((flag & OP_FLAG_EXPAND) ? 1 : 0) +
+         ((flag & OP_FLAG_OVERLAY) ? 1 : 0);
+}
+
+/// Fetch the redirects of a linked command, whose flags include a redirect.
+inline RedirectTable const *op_redirects(char **argv, size_t arg_count) {
+  return (RedirectTable const *)argv[arg_count + 2];
+}
+
+/// A variable used by a program.
+///
+/// Programs are compiled with the names of their variables, and
+/// `op_buffer_link` fills in their symbols, so that the interpreter finds
+/// their values without hashing, or searching the environment.
+typedef struct Variable {
+  StringHandle name;
+  Symbol symbol;
+} Variable;
+
+/// A piece of a word containing substitutions: some text, followed by the
+/// value of a variable.
+typedef struct ExpansionPart {
+  /// The index of the word in argv.
+  size_t arg;
+  /// The text, which becomes a C string once linked.
+  union {
+    StringHandle handle;
+    char const *string;
+  } text;
+  size_t text_len;
+  /// The variable, whose name is `STRING_HANDLE_NULL` for the text at the end
+  /// of a word, which has no variable after it.
+  Variable variable;
+} ExpansionPart;
+
+/// The substitutions of a command, laid out in the arena after its argv.
+///
+/// The parts of each word are next to each other, in order.
+typedef struct ExpansionTable {
+  size_t count;
+  ExpansionPart parts[];
+} ExpansionTable;
+
+/// Fetch the substitutions of a linked command, whose flags include
+/// `OP_FLAG_EXPAND`.
+inline ExpansionTable const *op_expansions(char **argv, size_t arg_count,
+                                           OpFlag flag) {
+  size_t index = arg_count + ((flag & OP_FLAG_REDIRECT) ? 3 : 2);
+  return (ExpansionTable const *)argv[index];
+}
+
+/// The variables a command overrides in its environment.
+///
+/// Their `NAME=value` bindings come right after the table, ending with NULL,
+/// ready to be put in the environment as is, once their substitutions, if
+/// any, have been expanded like any other word's.
+typedef struct OverlayTable {
+  size_t count;
+  /// The variable of each binding, filled in by `op_buffer_link`.
+  Symbol symbols[];
+} OverlayTable;
+
+/// Fetch the overlay of a linked command, whose flags include
+/// `OP_FLAG_OVERLAY`.
+inline OverlayTable const *op_overlay(char **argv, size_t arg_count,
+                                      OpFlag flag) {
+  return (OverlayTable const *)argv[arg_count + 1 + op_table_count(flag)];
+}
+
+/// Fetch the bindings of a linked command, whose flags include
+/// `OP_FLAG_OVERLAY`.
+inline char **op_bindings(char **argv, size_t arg_count, OpFlag flag) {
+  return argv + arg_count + 2 + op_table_count(flag);
+}
+
+/// An assignment, before it's known whether it's a command of its own, or
+/// comes before a command.
+typedef struct Assignment {
+  StringHandle name;
+  StringHandle value;
+  /// Whether the value is a template, as described for `TOKEN_EXPANSION`.
+  bool expansion;
+} Assignment;
+
+/// The data we have for a builtin operation.
+typedef struct OpDataBuiltin {
+  Builtin builtin;
+  /// The number of arguments, not counting the name of the builtin.
+  uint32_t arg_count;
+  /// The arguments, laid out in the arena like for commands.
+  StringHandle argv;
+} OpDataBuiltin;
+
 /// The data we have for a command operation.
 typedef struct OpDataCommand {
-  StringHandle name;
+  /// The name of the command, followed by its arguments, and NULL.
+  ///
+  /// This is an array in the arena, whose handles `op_buffer_link` turns into
+  /// C strings, ready to be passed to exec as is. With `OP_FLAG_REDIRECT`, a
+  /// table of redirects comes right after the NULL, see `op_redirects`.
+  StringHandle argv;
+  /// The number of arguments, not counting the name of the command.
   size_t arg_count;
 } OpDataCommand;
 
+/// The data we have for an assignment.
+typedef struct OpDataAssign {
+  /// The `Variable` assigned to, in the arena.
+  StringHandle variable;
+  /// The value, laid out like the argv of a command with no arguments, so
+  /// that it can contain substitutions like any other word.
+  StringHandle argv;
+} OpDataAssign;
+
 /// The variants of data held in a bytecode operation.
 typedef union OpData {
-  Builtin builtin;
+  OpDataBuiltin builtin;
   OpDataCommand command;
-  StringHandle string;
+  OpDataAssign assign;
+  /// The index of the operation a jump goes to, in the same buffer.
+  size_t target;
 } OpData;
 
 /// Represents a single operation in our bytecode.
 ///
-/// We have a stack-based language, and operations represent individual
-/// manipulations of that stack, and its environment.
+/// Each operation either runs a command with arguments laid out ahead of
+/// time, or controls which statements run.
 typedef struct Op {
   OpType type;
   OpFlag flag;
@@ -53,6 +209,24 @@ typedef struct OpBuffer {
   Op *ops;
   size_t len;
   size_t capacity;
+  /// Scratch space for the arguments of the command being compiled.
+  StringHandle *args;
+  size_t args_len;
+  size_t args_capacity;
+  /// Scratch space for the redirects of the command being compiled.
+  Redirect *redirects;
+  size_t redirects_len;
+  size_t redirects_capacity;
+  /// Scratch space for the substitutions of the command being compiled.
+  ExpansionPart *parts;
+  size_t parts_len;
+  size_t parts_capacity;
+  /// How many of the arguments gathered are bindings, which come first.
+  size_t bindings_len;
+  /// Scratch space for the assignments at the start of a command.
+  Assignment *assignments;
+  size_t assignments_len;
+  size_t assignments_capacity;
 } OpBuffer;
 
 /// Allocate memory for a new OpBuffer.
@@ -66,5 +240,25 @@ void op_buffer_reset(OpBuffer *buf);
 /// Free the memory of an Opbuffer, including the pointer itself.
 void op_buffer_free(OpBuffer *buf);
 
-/// compile a syntax tree into a linear buffer of stack operations.
-Error compile(ASTNode *input, OpBuffer *out);
+/// compile a syntax tree into a linear buffer of operations.
+///
+/// The operations are appended to the buffer, so that multiple trees can be
+/// compiled into the same program. The arguments of each command are laid
+/// out in the arena the tree's strings live in.
+Error compile(ASTNode *input, StringArena *arena, OpBuffer *out);
+
+/// Parse input and compile it in a single pass, without building a tree.
+///
+/// This produces the same operations as `parser_parse` followed by `compile`,
+/// which are kept around for tools which want to look at the tree itself.
+/// The operations are appended to the buffer, like with `compile`.
+Error compile_direct(Parser *parser, OpBuffer *out);
+
+/// Prepare a compiled program to run, in the arena it was compiled with.
+///
+/// This turns the arguments and redirects of each command into C strings, in
+/// place, so it should happen exactly once, after the program has been
+/// compiled and saved. The name of each variable is interned in the symbol
+/// table, which the program then needs to run with.
+/// Nothing can be allocated in the arena while the program runs.
+void op_buffer_link(OpBuffer *buf, StringArena *arena, SymbolTable *symbols);
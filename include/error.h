@@ -9,14 +9,28 @@ typedef enum ErrorType {
   ERROR_LEXER,
   ERROR_PARSER,
   ERROR_INTERPRETER,
-  ERROR_UNIX
+  ERROR_UNIX,
+  /// A redirect of a command failed, with the errno in `errnum`.
+  ///
+  /// This is kept apart from `ERROR_UNIX`, since a command which couldn't be
+  /// found fails with the same errors as a file which couldn't be opened.
+  ERROR_REDIRECT
 } ErrorType;
 
-typedef enum LexerError { LEXER_ERROR_UNKNOWN_INPUT } LexerError;
+typedef enum LexerError {
+  LEXER_ERROR_UNKNOWN_INPUT,
+  LEXER_ERROR_UNTERMINATED_QUOTE,
+  LEXER_ERROR_UNTERMINATED_HERE_DOC,
+  LEXER_ERROR_HERE_DOC_WORD,
+  LEXER_ERROR_BAD_SUBSTITUTION
+} LexerError;
 
 char const *lexer_error_str(LexerError err);
 
-typedef enum ParserError { PARSER_ERROR_UNEXPECTED_TOKEN } ParserError;
+typedef enum ParserError {
+  PARSER_ERROR_UNEXPECTED_TOKEN,
+  PARSER_ERROR_BACKGROUND_LIST
+} ParserError;
 
 char const *parser_error_str(ParserError err);
 
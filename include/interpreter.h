@@ -4,23 +4,89 @@
 #include "include/error.h"
 #include "include/parser.h"
 #include "include/string_arena.h"
+#include "include/symbol_table.h"
 
 /// Represents an interpreter running shell programs.
 typedef struct Interpreter Interpreter;
 
 /// Initialize a new interpreter.
 ///
+/// Programs get the values of their variables from the symbol table, which
+/// assignments and `export` change. Exported variables are passed on to the
+/// commands the interpreter runs.
+///
 /// The result can be freed with interpreter_free()
-Interpreter *interpreter_init(StringArena *arena);
+Interpreter *interpreter_init(StringArena *arena, SymbolTable *symbols);
 
 /// Free the memory of this interpreter, and the data inside.
 void interpreter_free(Interpreter *interpreter);
 
-/// Run the interpreter on a given ast node.
+/// Run the interpreter on a buffer of operations.
+///
+/// The operations need to have been linked with `op_buffer_link`, in the
+/// arena and symbol table the interpreter was created with.
+///
+/// An error in one statement is reported on stderr, and doesn't stop the
+/// statements after it from running.
 ///
 /// The interpreter should be reset between different runs.
 Error interpreter_run(Interpreter *interpreter, OpBuffer *buf);
 
+/// The exit status of the last statement which ran, like `$?` in sh.
+int interpreter_exit_status(Interpreter *interpreter);
+
+/// The hash builtin, which manages the cache of command locations.
+///
+/// With no arguments, this prints the cache, `-r` empties it, and any other
+/// arguments are looked up and added to the cache.
+int interpreter_builtin_hash(BuiltinEnv *env, char **argv);
+
+/// The pipestatus builtin, which prints the exit status of each stage of the
+/// last statement, like `$PIPESTATUS` in bash.
+int interpreter_builtin_pipestatus(BuiltinEnv *env, char **argv);
+
+/// The jobs builtin, which lists background jobs.
+///
+/// Jobs which have finished are listed one last time, and then forgotten.
+int interpreter_builtin_jobs(BuiltinEnv *env, char **argv);
+
+/// The wait builtin, which waits for background jobs to finish.
+///
+/// With no arguments, this waits for every job. Otherwise, each argument is
+/// either a job number, like `%1`, or the pid of one of a job's processes,
+/// and the status is that of the last job waited on.
+int interpreter_builtin_wait(BuiltinEnv *env, char **argv);
+
+/// The parallel builtin, which runs a command once for each input, with many
+/// copies running at once.
+///
+/// Inputs are given after `:::`, or read as lines from the input of the
+/// builtin, and added as the last argument of the command. `-j N` sets how
+/// many copies run at once, which is the number of cores by default. The
+/// output of each copy is collected, and printed once it exits.
+int interpreter_builtin_parallel(BuiltinEnv *env, char **argv);
+
+/// The export builtin, which passes variables on to the commands the shell
+/// runs.
+///
+/// Each argument is either a name, or `NAME=value`, which also sets the
+/// variable. With no arguments, this prints every exported variable, in a
+/// form which can be read back in.
+int interpreter_builtin_export(BuiltinEnv *env, char **argv);
+
+/// The unset builtin, which removes each variable named by its arguments,
+/// taking it out of the environment of commands too.
+int interpreter_builtin_unset(BuiltinEnv *env, char **argv);
+
+/// The value of a variable, or NULL if it isn't set.
+char const *interpreter_variable(Interpreter *interpreter, char const *name);
+
+/// Reap the processes of background jobs which have exited, without blocking.
+///
+/// If report isn't NULL, jobs which have finished are printed there, and then
+/// forgotten.
+void interpreter_poll_jobs(Interpreter *interpreter, FILE *report);
+
 /// Reset the state of the interpreter.
 ///
 /// We use resetting, instead of merely creating a new interpreter, in order
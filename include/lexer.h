@@ -1,10 +1,12 @@
 #pragma once
 
 #include "assert.h"
+#include "stdbool.h"
 #include "stddef.h"
 
 #include "include/builtin.h"
 #include "include/error.h"
+#include "include/redirect.h"
 #include "include/string_arena.h"
 typedef enum TokenType {
   /// Represents a builtin command
@@ -14,10 +16,41 @@ typedef enum TokenType {
   /// These are used as the arguments to builtin commands, or to represent
   /// the invocation of binaries, etc.
   TOKEN_WORD,
-  /// The token `>`.
-  TOKEN_ANGLE_RIGHT,
+  /// A word containing substitutions, like `$NAME`, `${NAME}`, or `$?`.
+  ///
+  /// Its string is a template, made of the text before the first
+  /// substitution, and then the name of each variable followed by the text
+  /// after it, all separated by null terminators, with an empty name at the
+  /// end. For example, `a$B"c$D"` becomes `a\0B\0c\0D\0\0\0`.
+  TOKEN_EXPANSION,
+  /// The start of an assignment, like `NAME=`, with the name as its string.
+  ///
+  /// This is only recognized at the start of a command, and the value comes
+  /// right after, as a word, or an expansion, which can be empty.
+  TOKEN_ASSIGNMENT,
+  /// A redirect, like `>`, `2>>`, `<`, or `2>&1`.
+  ///
+  /// The data has the kind of redirect, and its descriptor, which is the
+  /// digit right before the operator, if any. Redirects to and from files are
+  /// followed by a word with the path, while the others are complete.
+  ///
+  /// Here-documents, `<<` with a delimiter, and here-strings, `<<<` with a
+  /// word, carry the text to feed to the command. The body of a here-document
+  /// is on the lines after this token, which the lexer skips once it reaches
+  /// the end of this line. A here-string gets a line break added to its word.
+  TOKEN_REDIRECT,
   /// The token `|`
   TOKEN_PIPE,
+  /// The token `&`, running the statement before it in the background.
+  TOKEN_AMPERSAND,
+  /// The token `&&`, running what follows only if what precedes succeeded.
+  TOKEN_AND,
+  /// The token `||`, running what follows only if what precedes failed.
+  TOKEN_OR,
+  /// The token `;`, separating statements like a line break.
+  TOKEN_SEMICOLON,
+  /// A line break, separating different statements.
+  TOKEN_NEWLINE,
   /// Represents the end of the input stream
   TOKEN_EOF
 } TokenType;
@@ -27,6 +60,8 @@ typedef union TokenData {
   Builtin builtin;
   /// A handle containing some string data, allocated in an arena.
   StringHandle string;
+  /// A redirect, without its file, which is in the next token.
+  Redirect redirect;
 } TokenData;
 
 typedef struct Token {
@@ -38,13 +73,31 @@ typedef struct Token {
 
 typedef struct Lexer {
   char const *input;
+  size_t len;
   size_t index;
   StringArena *arena;
+  /// Whether the next word starts a command, making it a possible builtin.
+  bool command_start;
+  /// Where the bodies of the here-documents on this line end, or 0 if there
+  /// are none.
+  size_t here_doc_end;
+  /// Whether the next token is the value of an assignment.
+  bool assignment_value;
 } Lexer;
 
-inline Lexer lexer_init(char const *input, StringArena *arena) {
-  assert(input != NULL);
-  Lexer ret = {.input = input, .index = 0, .arena = arena};
+/// Create a lexer over some input.
+///
+/// The input doesn't need to be null-terminated, so files can be lexed
+/// directly from where they were mapped in memory.
+inline Lexer lexer_init(StringSlice input, StringArena *arena) {
+  assert(input.data != NULL);
+  Lexer ret = {.input = input.data,
+               .len = input.len,
+               .index = 0,
+               .arena = arena,
+               .command_start = true,
+               .here_doc_end = 0,
+               .assignment_value = false};
   return ret;
 }
 
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "stdbool.h"
+
+#include "include/error.h"
+#include "include/string_arena.h"
+
+/// Reads lines from a file descriptor, however long they are.
+///
+/// Input is read in large chunks, straight into a buffer which grows to fit
+/// the longest line, and each line is handed out as a slice of that buffer.
+typedef struct LineReader LineReader;
+
+/// Create a new reader, for a file descriptor it doesn't take ownership of.
+///
+/// The result should be freed with `line_reader_free`.
+LineReader *line_reader_init(int fd);
+
+/// Free a reader, along with its buffer.
+void line_reader_free(LineReader *reader);
+
+/// Read the next line, including its line break, if it has one.
+///
+/// The slice stays valid until the next call. At the end of the input,
+/// `eof_out` is set, and the slice is empty. The last line can lack a line
+/// break, in which case it's still returned before the end is reported.
+Error line_reader_next(LineReader *reader, StringSlice *out, bool *eof_out);
+
+/// Read the next line, as a continuation of the last one.
+///
+/// The slice starts where the last line did, and ends with the next line,
+/// for statements spanning several lines. If nothing comes after the last
+/// line, `eof_out` is set, and the slice is the last line alone.
+Error line_reader_extend(LineReader *reader, StringSlice *out, bool *eof_out);
@@ -1,63 +1,58 @@
 #pragma once
 
-#include "stdint.h"
+#include "stdbool.h"
 
-#include "include/builtin.h"
+#include "include/ast.h"
 #include "include/error.h"
 #include "include/lexer.h"
 #include "include/string_arena.h"
 
-/// Represents one of the variants in our AST.
-typedef enum ASTType {
-  /// Represents a builtin command for our shell.
-  AST_BUILTIN,
-  /// Represents an arbitrary command that isn't builtin.
-  AST_COMMAND,
-  /// Represent an individual argument for some command.
-  AST_ARG,
-  /// Represents a redirection to a certain file.
-  AST_REDIRECT,
-  /// Represents the piping between two processes.
-  AST_PIPE
-} ASTType;
-
-/// Represents one of the nodes in our AST.
-typedef struct ASTNode ASTNode;
-
-/// Represents one of the kinds of data our AST can handle.
-typedef union ASTData {
-  StringHandle string;
-} ASTData;
-
-struct ASTNode {
-  /// The variant this node is.
-  ASTType type;
-  /// The number if children under this node, if relevant.
-  uint64_t count;
-  /// The builtin associated with this node, if any.
-  Builtin builtin;
-  /// The children beneath this node, if any.
-  ASTNode *children;
-  /// Additional data associated with this node.
-  ASTData data;
-};
-
-/// Free all of the memory allocated inside of an AST.
-///
-/// This recursively traverses the tree to free all nodes contained inside.
-void ast_free(ASTNode *node);
-
 /// Represents a parser, which uses the tokens produced by the lexer to make an
 /// AST.
-typedef struct Parser Parser;
+typedef struct Parser {
+  Lexer *lexer;
+  ASTArena *arena;
+  Token peek;
+  bool has_peek;
+  Token prev;
+} Parser;
+
+/// Create a parser, reading tokens from a lexer.
+///
+/// Nodes are allocated in the arena, and live until it gets reset. The arena
+/// can be NULL if the parser is only used for its tokens, by `compile_direct`.
+inline Parser parser_init(Lexer *lexer, ASTArena *arena) {
+  Parser ret = {.lexer = lexer, .arena = arena, .has_peek = false};
+  return ret;
+}
+
+/// Look at the next token, without consuming it.
+Error parse_peek(Parser *parser, Token *out);
+
+/// Consume the token returned by the last call to `parse_peek`.
+///
+/// That token then becomes `parser->prev`.
+void parse_advance(Parser *parser);
+
+/// Check whether the next token has a given type, without consuming it.
+Error parse_check(Parser *parser, TokenType type, bool *out);
+
+/// Consume the next token, failing if it doesn't have a given type.
+Error parse_consume(Parser *parser, TokenType type);
 
-/// Initialize a parser, with a given lexer.
+/// Check whether the next token is a word, with or without substitutions.
+Error parse_check_word(Parser *parser, bool *out);
+
+/// Parse a redirect, along with its file, if the next token starts one.
 ///
-/// The result can be freed with `parser_free`.
-Parser *parser_init(Lexer *lexer);
+/// This sets `found_out` to whether there was a redirect.
+Error parse_redirect(Parser *parser, bool *found_out, Redirect *out);
 
-/// This frees the data inside parser, and the memory of parser as well;
-void parser_free(Parser *parser);
+/// Skip over line breaks, returning whether or not the input has ended.
+Error parse_skip_newlines(Parser *parser, bool *eof_out);
 
 /// Parse data, producing a full AST.
+///
+/// The result is always an `AST_SEQUENCE`, with one child for each of the
+/// statements in the input, which are separated by line breaks, or `;`.
 Error parser_parse(Parser *parser, ASTNode *out);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "stddef.h"
+#include "stdio.h"
+
+#include "include/error.h"
+
+/// Feeds the output of builtins into pipes, without blocking the shell.
+///
+/// Builtins in a pipeline run inside the shell, before the stages reading
+/// their output have even started. Their output goes straight into the pipe
+/// while it has room, and once it's full, a helper thread takes over.
+typedef struct PipeWriters PipeWriters;
+
+/// Allocate a new set of writers.
+///
+/// The result should be freed with `pipe_writers_free`.
+PipeWriters *pipe_writers_init();
+
+/// Free a set of writers, after waiting for them to finish.
+void pipe_writers_free(PipeWriters *writers);
+
+/// Open a stream on the write end of a pipe, for the output of a builtin.
+///
+/// Writes go into the pipe without blocking until it's full. After that, a
+/// helper thread writes the rest as the reader catches up, and closes the
+/// pipe once the stream has been closed, and everything has been written, or
+/// the reader has gone away. The descriptor should be close on exec, so that
+/// the processes started in the meantime don't keep the pipe open.
+///
+/// The stream owns the descriptor, and returns NULL, setting errno, if it
+/// couldn't be opened, in which case the descriptor is closed.
+FILE *pipe_writers_open(PipeWriters *writers, int fd);
+
+/// Move every ongoing write into a new set of writers, leaving this one empty.
+///
+/// This returns NULL, without allocating anything, if there are none. Otherwise
+/// the result should be freed with `pipe_writers_free`, which waits for them.
+PipeWriters *pipe_writers_take(PipeWriters *writers);
+
+/// Wait for every ongoing write to finish.
+///
+/// Writes finish once everything has been read, or once the reading end
+/// has been closed.
+void pipe_writers_join(PipeWriters *writers);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "sys/types.h"
+
+#include "include/error.h"
+
+/// Waits on many child processes at once, reaping each as soon as it exits.
+///
+/// Children are watched through a pidfd each, all registered with a single
+/// epoll instance. On kernels without pidfds, children are waited on one
+/// after the other instead.
+typedef struct Reaper Reaper;
+
+/// Create a new reaper.
+///
+/// The result should be freed with `reaper_free`.
+Reaper *reaper_init();
+
+/// Free a reaper, along with the descriptors it holds.
+///
+/// Children still being watched are not waited on.
+void reaper_free(Reaper *reaper);
+
+/// Start watching a child, identified by a tag when it gets reaped.
+void reaper_watch(Reaper *reaper, pid_t pid, size_t tag);
+
+/// The number of children being watched which haven't been reaped yet.
+size_t reaper_pending(Reaper *reaper);
+
+/// Wait for the next child to exit, and reap it.
+///
+/// This provides the tag the child was watched with, along with its status,
+/// as returned by `waitpid`. There needs to be at least one pending child.
+/// The child is no longer pending afterwards, even if this fails.
+Error reaper_wait(Reaper *reaper, size_t *tag_out, int *status_out);
+
+/// Reap a child which has already exited, without blocking.
+///
+/// This sets `reaped_out` to whether a child was reaped, in which case its tag
+/// and status are provided, like with `reaper_wait`.
+Error reaper_poll(Reaper *reaper, size_t *tag_out, int *status_out,
+                  bool *reaped_out);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "fcntl.h"
+#include "stdbool.h"
+#include "stddef.h"
+
+#include "include/string_arena.h"
+
+/// The different kinds of redirects a command can have.
+typedef enum RedirectType {
+  /// Write to a file, truncating it first, with `>`.
+  REDIRECT_WRITE,
+  /// Write to the end of a file, with `>>`.
+  REDIRECT_APPEND,
+  /// Read from a file, with `<`.
+  REDIRECT_READ,
+  /// Read a string, from a here-document whose delimiter is quoted.
+  REDIRECT_STRING,
+  /// Read a string with substitutions, from a here-document whose delimiter
+  /// isn't quoted, or a here-string.
+  REDIRECT_TEMPLATE,
+  /// Make a descriptor a copy of another one, like with `2>&1`.
+  REDIRECT_DUP,
+} RedirectType;
+
+/// A single redirect, applied to one of the descriptors of a command.
+typedef struct Redirect {
+  RedirectType type;
+  /// The descriptor being redirected.
+  int fd;
+  union {
+    /// The file or the string, until `op_buffer_link` turns it into a C
+    /// string, in `string`.
+    ///
+    /// For `REDIRECT_TEMPLATE`, the lexer leaves a template here, as described
+    /// for `TOKEN_EXPANSION`, which compiling turns into a table of its
+    /// substitutions, and linking into `expansion`.
+    StringHandle handle;
+    char *string;
+    struct ExpansionTable const *expansion;
+    /// The descriptor copied by `REDIRECT_DUP`.
+    int source_fd;
+  } data;
+} Redirect;
+
+/// The redirects of a command, applied one after the other.
+///
+/// These are laid out in the arena when compiling, so that running a command
+/// only needs to hand them over to the child, or to spawn.
+typedef struct RedirectTable {
+  size_t count;
+  Redirect redirects[];
+} RedirectTable;
+
+/// Whether a redirect opens a file, by its path.
+inline bool redirect_opens_file(RedirectType type) {
+  return type == REDIRECT_WRITE || type == REDIRECT_APPEND ||
+         type == REDIRECT_READ;
+}
+
+/// Whether a redirect has a string, either a path or text, in its data.
+inline bool redirect_has_string(RedirectType type) {
+  return type != REDIRECT_DUP && type != REDIRECT_TEMPLATE;
+}
+
+/// Whether a redirect feeds text to its descriptor, from a here-document or a
+/// here-string.
+inline bool redirect_reads_string(RedirectType type) {
+  return type == REDIRECT_STRING || type == REDIRECT_TEMPLATE;
+}
+
+/// The flags a redirect opens its file with, if it opens one.
+inline int redirect_open_flags(RedirectType type) {
+  switch (type) {
+  case REDIRECT_WRITE:
+    return O_WRONLY | O_CREAT | O_TRUNC;
+  case REDIRECT_APPEND:
+    return O_WRONLY | O_CREAT | O_APPEND;
+  default:
+    return O_RDONLY;
+  }
+}
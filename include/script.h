@@ -0,0 +1,45 @@
+#pragma once
+
+#include "stdbool.h"
+#include "time.h"
+
+#include "include/compiler.h"
+#include "include/error.h"
+#include "include/interpreter.h"
+#include "include/string_arena.h"
+#include "include/symbol_table.h"
+
+/// The source code of a script, loaded in memory.
+typedef struct Script {
+  /// The contents of the script.
+  StringSlice source;
+  /// Whether or not the contents were mapped, instead of being allocated.
+  bool mapped;
+  /// When the script was last modified, or zero if it isn't a regular file.
+  struct timespec mtime;
+} Script;
+
+/// Load a script from a file descriptor.
+///
+/// Regular files get mapped into memory, while anything else, like a pipe,
+/// gets read until the end.
+///
+/// The result should be released with `script_close`.
+Error script_open(int fd, Script *out);
+
+/// Release the memory used by a script.
+void script_close(Script *script);
+
+/// Run an entire script.
+///
+/// Every statement in the script is compiled up front, into a single buffer
+/// of operations, which is then run from start to finish. This means that a
+/// script with a syntax error won't run at all.
+///
+/// If the path of the script is known, the compiled program is saved in the
+/// bytecode cache, and reused on later runs if the script hasn't changed.
+/// Names of variables are only resolved when linking, so a cached program
+/// works with whatever variables the shell has.
+Error script_run(char const *path, Script *script, StringArena *arena,
+                 SymbolTable *symbols, Interpreter *interpreter,
+                 OpBuffer *op_buffer);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "sys/types.h"
+
+#include "include/error.h"
+#include "include/redirect.h"
+
+/// The different strategies we can use to start an external command.
+typedef enum SpawnBackend {
+  /// Use `fork`, followed by `execve` in the child.
+  ///
+  /// Failures to exec are sent back to the parent through an extra pipe.
+  SPAWN_BACKEND_FORK,
+  /// Use `posix_spawn`, on the path the command was already resolved to.
+  ///
+  /// On Linux, this uses `clone(CLONE_VM | CLONE_VFORK)` under the hood, so
+  /// the page tables of the shell never get copied, and failures to exec are
+  /// reported directly as the result of the call.
+  SPAWN_BACKEND_POSIX_SPAWN
+} SpawnBackend;
+
+/// The backend to use when nothing else has been asked for.
+///
+/// This can be chosen at build time by defining `SALLY_SPAWN_BACKEND_FORK`.
+#ifdef SALLY_SPAWN_BACKEND_FORK
+#define SPAWN_BACKEND_DEFAULT SPAWN_BACKEND_FORK
+#else
+#define SPAWN_BACKEND_DEFAULT SPAWN_BACKEND_POSIX_SPAWN
+#endif
+
+/// Figure out which backend to use, based on the environment.
+///
+/// The variable `SALLY_SPAWN_BACKEND` can be set to `fork` or `posix_spawn`
+/// in order to override the default backend at runtime.
+SpawnBackend spawn_backend_from_env();
+
+/// The descriptors a command starts with.
+///
+/// These only ever get set up in the child, so the descriptors of the shell
+/// itself are never touched.
+typedef struct SpawnIO {
+  /// The standard input and output of the child, or -1 to inherit the shell's
+  /// own, usually the ends of pipes.
+  int stdin_fd;
+  int stdout_fd;
+  /// The redirects of the command, applied in order after the pipes, or NULL.
+  RedirectTable const *redirects;
+  /// A descriptor for each here-document or here-string in the table, in
+  /// order, which already holds its text, expanded.
+  int const *string_fds;
+} SpawnIO;
+
+/// Spawn an external command, without forking the shell.
+///
+/// The path should already have been resolved, e.g. with a `CommandCache`.
+/// The environment is passed on as is, like `symbol_table_environ` gives it.
+///
+/// Failing to execute the program is reported as an error, and no process is
+/// left behind in that case. Failing to open the file of a redirect is
+/// reported as `ERROR_REDIRECT`.
+Error spawn_command(char const *path, char **argv, char **envp,
+                    SpawnIO const *io, pid_t *pid_out);
+
+/// Set up the descriptors of a forked child, before it runs its command.
+///
+/// This returns 0, or the errno of the first redirect which failed.
+int spawn_io_apply(SpawnIO const *io);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "stdbool.h"
+#include "stdint.h"
+#include "stdio.h"
+
+/// The stages of running a command that we keep timings for.
+typedef enum StatsStage {
+  /// Turning source into operations.
+  ///
+  /// Lexing, parsing and compiling happen together, in a single pass.
+  STATS_PARSE,
+  /// Starting a process, up to the point where the shell can go on.
+  ///
+  /// With posix_spawn, this includes the exec, but with fork, it doesn't.
+  STATS_LAUNCH,
+  /// Checking whether a forked process managed to exec.
+  STATS_EXEC_CHECK,
+  /// Waiting for every process in a statement to exit.
+  STATS_WAIT,
+  /// Not a stage, but the number of stages.
+  STATS_STAGE_COUNT
+} StatsStage;
+
+/// Read the monotonic clock, in nanoseconds.
+uint64_t stats_now();
+
+/// Record how long a stage took, given the time it started at.
+///
+/// This only updates a few counters, so that it can always be on.
+void stats_record(StatsStage stage, uint64_t start_ns);
+
+/// Forget every timing recorded so far.
+void stats_reset();
+
+/// Print a table with the timings of each stage.
+///
+/// Percentiles come from power of two buckets, so they're rounded up to the
+/// end of the bucket they fall in.
+void stats_print(FILE *out);
+
+/// Whether the timings should be printed when the shell exits.
+///
+/// This is enabled by setting `SALLY_STATS` to anything other than `0`.
+bool stats_dump_enabled();
@@ -33,6 +33,9 @@ inline int stringslice_cmp_str(StringSlice slice, char const *str) {
 /// if the arena memory is relocated.
 typedef size_t StringHandle;
 
+/// A handle which doesn't refer to any string, becoming NULL once linked.
+#define STRING_HANDLE_NULL ((StringHandle)-1)
+
 /// An arena used to allocate strings.
 ///
 /// Better than individual mallocs, most likely.
@@ -53,6 +56,59 @@ void string_arena_free(StringArena *arena);
 /// with `string_arena_get_str`.
 StringHandle string_arena_alloc(StringArena *arena, StringSlice slice);
 
+/// Start building a string in the arena, piece by piece.
+///
+/// Pieces are added with `string_arena_append`, and the string is finished
+/// with `string_arena_end`. No other allocation can happen in the meantime.
+StringHandle string_arena_begin(StringArena *arena);
+
+/// Add a piece to the end of the string being built.
+void string_arena_append(StringArena *arena, StringSlice slice);
+
+/// Finish building a string, adding the null terminator.
+void string_arena_end(StringArena *arena);
+
+/// Reserve space for some other kind of data in the arena.
+///
+/// The space is aligned for any structure of handles, or of pointers, and is
+/// accessed with `string_arena_get_data`.
+StringHandle string_arena_reserve(StringArena *arena, size_t size);
+
+/// Fetch the data reserved with `string_arena_reserve`.
+///
+/// Like strings, this is only valid until the next allocation.
+void *string_arena_get_data(StringArena *arena, StringHandle handle);
+
+/// Allocate an array of handles in the arena, returning a handle to it.
+///
+/// The array is aligned so that `string_arena_link_argv` can later turn it
+/// into an array of C strings, in place.
+StringHandle string_arena_alloc_argv(StringArena *arena,
+                                     StringHandle const *handles,
+                                     size_t count);
+
+/// Turn an array from `string_arena_alloc_argv` into an array of C strings.
+///
+/// This happens in place, with `STRING_HANDLE_NULL` becoming NULL, so it
+/// needs to happen exactly once. The pointers are only valid until the next
+/// allocation, so the arena shouldn't grow anymore afterwards.
+void string_arena_link_argv(StringArena *arena, StringHandle argv,
+                            size_t count);
+
+/// Fetch an array of C strings, after `string_arena_link_argv`.
+char **string_arena_get_argv(StringArena *arena, StringHandle argv);
+
+/// Get a view of every string allocated in the arena so far.
+///
+/// Handles are offsets into this data, which makes it possible to save the
+/// contents of an arena, and to restore them later with `string_arena_load`.
+StringSlice string_arena_contents(StringArena *arena);
+
+/// Replace the contents of an arena with data from `string_arena_contents`.
+///
+/// Handles that were valid for the saved arena are valid for this one.
+void string_arena_load(StringArena *arena, StringSlice contents);
+
 /// Fetch the null-terminated string associated with a handle.
 ///
 /// This string is only guaranteed to be valid until the next
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#include "include/string_arena.h"
+
+/// A variable name, interned in a `SymbolTable`.
+///
+/// Symbols are indices, so finding the value of a variable whose name was
+/// interned ahead of time is a single array access, with no hashing.
+typedef uint32_t Symbol;
+
+/// A symbol which doesn't refer to any variable.
+#define SYMBOL_NONE ((Symbol)-1)
+
+/// The variables of the shell, along with their values.
+///
+/// Names are interned once in an open addressing hash table, which lives for
+/// as long as the shell, next to the `StringArena` programs are compiled in.
+/// A symbol stays valid for the whole life of the table.
+typedef struct SymbolTable SymbolTable;
+
+/// Allocate a new, empty symbol table.
+///
+/// The result should be freed with `symbol_table_free`.
+SymbolTable *symbol_table_init();
+
+/// Free the memory of a symbol table, including the pointer itself.
+void symbol_table_free(SymbolTable *table);
+
+/// Set a variable for each `NAME=value` string in an environment, marking
+/// each one as exported.
+void symbol_table_import(SymbolTable *table, char **envp);
+
+/// Find the symbol for a name, interning it if it hasn't been seen before.
+Symbol symbol_table_intern(SymbolTable *table, StringSlice name);
+
+/// The number of symbols interned so far, which are numbered from 0.
+size_t symbol_table_count(SymbolTable *table);
+
+/// The name a symbol was interned with.
+///
+/// This is only valid until the next symbol is interned.
+char const *symbol_table_name(SymbolTable *table, Symbol symbol);
+
+/// The value of a variable, whose data is NULL if it isn't set.
+///
+/// The value is null-terminated, and valid until the variable is next set.
+StringSlice symbol_table_get(SymbolTable *table, Symbol symbol);
+
+/// Set the value of a variable, copying it into the table.
+///
+/// The memory of each variable is reused, so setting it to a value no larger
+/// than any it had before doesn't allocate.
+void symbol_table_set(SymbolTable *table, Symbol symbol, StringSlice value);
+
+/// Remove a variable, which is then neither set, nor exported.
+void symbol_table_unset(SymbolTable *table, Symbol symbol);
+
+/// Mark a variable as exported, so that commands get it in their environment.
+void symbol_table_export(SymbolTable *table, Symbol symbol);
+
+/// Whether a variable has been exported.
+bool symbol_table_exported(SymbolTable *table, Symbol symbol);
+
+/// The environment to start commands with, as `NAME=value` strings, followed
+/// by NULL.
+///
+/// This array is kept up to date as variables are set, exported, and unset,
+/// patching only the entry that changed, so it can be passed to exec as is.
+/// It's valid until the next one of those changes.
+char **symbol_table_environ(SymbolTable *table);
+
+/// Add `NAME=value` bindings to the environment, for a single command.
+///
+/// A binding for an exported variable takes the place of its entry, and the
+/// others go in front of the environment, in slots kept free for them, so
+/// that nothing else gets copied. They stay in place until
+/// `symbol_table_restore` is called, with the same symbols.
+void symbol_table_overlay(SymbolTable *table, Symbol const *symbols,
+                          char *const *bindings, size_t count);
+
+/// Take the bindings of `symbol_table_overlay` back out of the environment.
+void symbol_table_restore(SymbolTable *table, Symbol const *symbols,
+                          size_t count);
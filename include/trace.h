@@ -0,0 +1,45 @@
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+#include "sys/types.h"
+
+#include "include/redirect.h"
+
+/// Details attached to a span, any of which can be left out.
+typedef struct TraceArgs {
+  /// The process this span is about, or 0.
+  pid_t pid;
+  /// The name of the command this span is about, or NULL.
+  char const *argv0;
+  /// The position of the command in its pipeline, if argv0 is set.
+  size_t stage;
+  /// The redirects of the command, whose files are listed, or NULL.
+  RedirectTable const *redirects;
+} TraceArgs;
+
+/// Start tracing, if `SALLY_TRACE` names a file to write the trace to.
+///
+/// The trace is in the trace event format, which can be loaded into
+/// chrome://tracing or Perfetto.
+void trace_init();
+
+/// Whether or not tracing is enabled.
+bool trace_enabled();
+
+/// Record a span, from a time given by `stats_now` up to now.
+///
+/// Spans with the same track are shown on the same row, with 0 being the
+/// shell's own track. Events are only buffered in memory, so this never
+/// blocks on the trace file.
+void trace_span(char const *name, uint64_t start_ns, pid_t track,
+                TraceArgs const *args);
+
+/// Write out buffered events, if enough of them have accumulated.
+///
+/// This should be called between statements, off of the hot path.
+void trace_flush_if_full();
+
+/// Write out every buffered event, and finish the trace file.
+void trace_finish();
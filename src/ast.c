@@ -0,0 +1,136 @@
+#include "string.h"
+
+#include "include/ast.h"
+#include "include/error.h"
+
+/// A block of memory nodes are allocated from.
+typedef struct ASTBlock {
+  ASTNode *nodes;
+  size_t len;
+  size_t capacity;
+} ASTBlock;
+
+struct ASTArena {
+  /// The blocks we've allocated, which are kept around when resetting.
+  ASTBlock *blocks;
+  size_t block_count;
+  size_t block_capacity;
+  /// The block nodes are currently allocated from.
+  size_t current;
+
+  ASTNode *scratch;
+  size_t scratch_len;
+  size_t scratch_capacity;
+};
+
+const size_t AST_ARENA_BLOCK_SIZE = 256;
+const size_t AST_ARENA_SCRATCH_SIZE = 64;
+
+/// Add a new block, big enough to hold at least `min` nodes.
+static void ast_arena_add_block(ASTArena *arena, size_t min) {
+  if (arena->block_count >= arena->block_capacity) {
+    arena->block_capacity =
+        arena->block_capacity == 0 ? 4 : arena->block_capacity * 2;
+    arena->blocks =
+        realloc(arena->blocks, arena->block_capacity * sizeof(ASTBlock));
+    if (arena->blocks == NULL) {
+      panic("ast_arena: failed to allocate memory");
+    }
+  }
+  // Each block is bigger than the last, so that long scripts need few blocks.
+  size_t capacity = AST_ARENA_BLOCK_SIZE;
+  if (arena->block_count > 0) {
+    capacity = arena->blocks[arena->block_count - 1].capacity * 2;
+  }
+  while (capacity < min) {
+    capacity *= 2;
+  }
+  ASTNode *nodes = malloc(capacity * sizeof(ASTNode));
+  if (nodes == NULL) {
+    panic("ast_arena: failed to allocate memory");
+  }
+  arena->blocks[arena->block_count++] =
+      (ASTBlock){.nodes = nodes, .len = 0, .capacity = capacity};
+}
+
+ASTArena *ast_arena_init() {
+  ASTArena *out = malloc(sizeof(ASTArena));
+  if (out == NULL) {
+    panic("ast_arena_init: failed to allocate memory");
+  }
+  out->blocks = NULL;
+  out->block_count = 0;
+  out->block_capacity = 0;
+  out->current = 0;
+  ast_arena_add_block(out, 0);
+
+  out->scratch_len = 0;
+  out->scratch_capacity = AST_ARENA_SCRATCH_SIZE;
+  out->scratch = malloc(out->scratch_capacity * sizeof(ASTNode));
+  if (out->scratch == NULL) {
+    panic("ast_arena_init: failed to allocate memory");
+  }
+  return out;
+}
+
+void ast_arena_reset(ASTArena *arena) {
+  arena->current = 0;
+  arena->blocks[0].len = 0;
+  arena->scratch_len = 0;
+}
+
+void ast_arena_free(ASTArena *arena) {
+  for (size_t i = 0; i < arena->block_count; ++i) {
+    free(arena->blocks[i].nodes);
+  }
+  free(arena->blocks);
+  free(arena->scratch);
+  free(arena);
+}
+
+void ast_arena_push(ASTArena *arena, ASTNode node) {
+  if (arena->scratch_len >= arena->scratch_capacity) {
+    arena->scratch_capacity *= 2;
+    arena->scratch =
+        realloc(arena->scratch, arena->scratch_capacity * sizeof(ASTNode));
+    if (arena->scratch == NULL) {
+      panic("ast_arena: failed to allocate memory");
+    }
+  }
+  arena->scratch[arena->scratch_len++] = node;
+}
+
+size_t ast_arena_mark(ASTArena *arena) {
+  return arena->scratch_len;
+}
+
+ASTNode ast_arena_pop(ASTArena *arena) {
+  return arena->scratch[--arena->scratch_len];
+}
+
+/// Allocate room for some nodes, which stays valid until the next reset.
+static ASTNode *ast_arena_alloc(ASTArena *arena, size_t count) {
+  ASTBlock *block = arena->blocks + arena->current;
+  while (block->capacity - block->len < count) {
+    // Blocks from before the last reset get reused first.
+    if (arena->current + 1 >= arena->block_count) {
+      ast_arena_add_block(arena, count);
+    }
+    block = arena->blocks + ++arena->current;
+    block->len = 0;
+  }
+  ASTNode *out = block->nodes + block->len;
+  block->len += count;
+  return out;
+}
+
+ASTNode *ast_arena_commit(ASTArena *arena, size_t mark) {
+  size_t count = arena->scratch_len - mark;
+  if (count == 0) {
+    return NULL;
+  }
+  ASTNode *out = ast_arena_alloc(arena, count);
+  memcpy(out, arena->scratch + mark, count * sizeof(ASTNode));
+  arena->scratch_len = mark;
+  return out;
+}
@@ -0,0 +1,508 @@
+#include "errno.h"
+#include "limits.h"
+#include "stdint.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/stat.h"
+#include "unistd.h"
+
+#include "include/builtin.h"
+#include "include/interpreter.h"
+#include "include/stats.h"
+
+static int builtin_pwd(BuiltinEnv *env, char **argv) {
+  (void)argv;
+  char buf[PATH_MAX];
+  if (getcwd(buf, PATH_MAX) == NULL) {
+    fprintf(env->err, "pwd: %s\n", strerror(errno));
+    return 1;
+  }
+  fputs(buf, env->out);
+  fputc('\n', env->out);
+  return 0;
+}
+
+static int builtin_cd(BuiltinEnv *env, char **argv) {
+  char const *dir = argv[1];
+  if (dir == NULL) {
+    dir = interpreter_variable(env->interpreter, "HOME");
+    if (dir == NULL) {
+      fputs("cd: HOME not set\n", env->err);
+      return 1;
+    }
+  }
+  if (chdir(dir) < 0) {
+    fprintf(env->err, "cd: %s: %s\n", dir, strerror(errno));
+    return 1;
+  }
+  return 0;
+}
+
+static int builtin_echo(BuiltinEnv *env, char **argv) {
+  bool newline = true;
+  char **arg = argv + 1;
+  if (*arg != NULL && strcmp(*arg, "-n") == 0) {
+    newline = false;
+    ++arg;
+  }
+  for (char **first = arg; *arg != NULL; ++arg) {
+    if (arg != first) {
+      fputc(' ', env->out);
+    }
+    fputs(*arg, env->out);
+  }
+  if (newline) {
+    fputc('\n', env->out);
+  }
+  return 0;
+}
+
+/// Print the escape sequence starting after a backslash, like `\n`.
+///
+/// This advances the pointer past the sequence.
+static void print_escape(FILE *out, char const **at) {
+  char c = **at;
+  switch (c) {
+  case 'a': {
+    fputc('\a', out);
+    break;
+  }
+  case 'b': {
+    fputc('\b', out);
+    break;
+  }
+  case 'f': {
+    fputc('\f', out);
+    break;
+  }
+  case 'n': {
+    fputc('\n', out);
+    break;
+  }
+  case 'r': {
+    fputc('\r', out);
+    break;
+  }
+  case 't': {
+    fputc('\t', out);
+    break;
+  }
+  case 'v': {
+    fputc('\v', out);
+    break;
+  }
+  case '0': {
+    // Up to 3 octal digits follow
+    int value = 0;
+    for (int i = 0; i < 3 && (*at)[1] >= '0' && (*at)[1] <= '7'; ++i) {
+      value = value * 8 + (*++*at - '0');
+    }
+    fputc(value, out);
+    break;
+  }
+  case 0: {
+    // A trailing backslash is kept as is.
+    fputc('\\', out);
+    return;
+  }
+  case '\\': {
+    fputc('\\', out);
+    break;
+  }
+  default: {
+    fputc('\\', out);
+    fputc(c, out);
+    break;
+  }
+  }
+  ++*at;
+}
+
+/// Parse a number for printf, returning false if it's invalid.
+static bool printf_number(FILE *err, char const *arg, bool is_signed,
+                          long long *out) {
+  if (arg[0] == 0) {
+    *out = 0;
+    return true;
+  }
+  // Like in sh, a leading quote gives the value of the next character.
+  if (arg[0] == '\'' || arg[0] == '"') {
+    *out = (unsigned char)arg[1];
+    return true;
+  }
+  char *end;
+  errno = 0;
+  *out = is_signed ? strtoll(arg, &end, 0) : (long long)strtoull(arg, &end, 0);
+  if (errno != 0 || *end != 0) {
+    fprintf(err, "printf: %s: invalid number\n", arg);
+    *out = 0;
+    return false;
+  }
+  return true;
+}
+
+/// Print the format once, consuming arguments as needed.
+///
+/// This returns the exit status, which is non zero if an argument was invalid.
+static int printf_once(FILE *out, FILE *err, char const *format,
+                       char ***args) {
+  int status = 0;
+  for (char const *at = format; *at != 0;) {
+    if (*at == '\\') {
+      ++at;
+      print_escape(out, &at);
+      continue;
+    }
+    if (*at != '%') {
+      fputc(*at++, out);
+      continue;
+    }
+    if (at[1] == '%') {
+      fputc('%', out);
+      at += 2;
+      continue;
+    }
+
+    // Copy the flags, width, and precision, so that fprintf handles them.
+    char spec[32] = "%";
+    size_t spec_len = 1;
+    for (++at; *at != 0 && strchr("-+ #0123456789.", *at) != NULL; ++at) {
+      if (spec_len < sizeof(spec) - 4) {
+        spec[spec_len++] = *at;
+      }
+    }
+    char conv = *at;
+    if (conv == 0) {
+      fputs("printf: missing conversion\n", err);
+      return 1;
+    }
+    ++at;
+
+    char const *arg = "";
+    if (**args != NULL) {
+      arg = *(*args)++;
+    }
+    long long number;
+    switch (conv) {
+    case 'd':
+    case 'i': {
+      spec[spec_len++] = 'l';
+      spec[spec_len++] = 'l';
+      spec[spec_len++] = conv;
+      if (!printf_number(err, arg, true, &number)) {
+        status = 1;
+      }
+      fprintf(out, spec, number);
+      break;
+    }
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X': {
+      spec[spec_len++] = 'l';
+      spec[spec_len++] = 'l';
+      spec[spec_len++] = conv;
+      if (!printf_number(err, arg, false, &number)) {
+        status = 1;
+      }
+      fprintf(out, spec, (unsigned long long)number);
+      break;
+    }
+    case 'c': {
+      // An empty argument has no first character, so only the padding, if
+      // any, gets printed, rather than a NUL.
+      if (arg[0] == '\0') {
+        spec[spec_len++] = 's';
+        fprintf(out, spec, "");
+        break;
+      }
+      spec[spec_len++] = 'c';
+      fprintf(out, spec, arg[0]);
+      break;
+    }
+    case 's': {
+      spec[spec_len++] = 's';
+      fprintf(out, spec, arg);
+      break;
+    }
+    case 'b': {
+      for (char const *b = arg; *b != 0;) {
+        if (*b == '\\') {
+          ++b;
+          print_escape(out, &b);
+        } else {
+          fputc(*b++, out);
+        }
+      }
+      break;
+    }
+    default: {
+      fprintf(err, "printf: %%%c: invalid conversion\n", conv);
+      return 1;
+    }
+    }
+  }
+  return status;
+}
+
+static int builtin_printf(BuiltinEnv *env, char **argv) {
+  if (argv[1] == NULL) {
+    fputs("printf: usage: printf format [arguments]\n", env->err);
+    return 2;
+  }
+  char **args = argv + 2;
+  int status = 0;
+  // The format is reused as long as it consumes arguments.
+  for (;;) {
+    char **before = args;
+    status |= printf_once(env->out, env->err, argv[1], &args);
+    if (*args == NULL || args == before) {
+      break;
+    }
+  }
+  return status;
+}
+
+/// Parse an integer operand of test, returning false if it's invalid.
+static bool test_number(FILE *err, char const *arg, long long *out) {
+  char *end;
+  errno = 0;
+  *out = strtoll(arg, &end, 10);
+  if (errno != 0 || end == arg || *end != 0) {
+    fprintf(err, "test: %s: integer expression expected\n", arg);
+    return false;
+  }
+  return true;
+}
+
+/// Evaluate a unary test, like `-f file`, returning -1 for an unknown operator.
+static int test_unary(char const *op, char const *arg) {
+  if (op[0] != '-' || op[1] == 0 || op[2] != 0) {
+    return -1;
+  }
+  struct stat info;
+  switch (op[1]) {
+  case 'n':
+    return arg[0] != 0;
+  case 'z':
+    return arg[0] == 0;
+  case 'e':
+    return stat(arg, &info) == 0;
+  case 'f':
+    return stat(arg, &info) == 0 && S_ISREG(info.st_mode);
+  case 'd':
+    return stat(arg, &info) == 0 && S_ISDIR(info.st_mode);
+  case 's':
+    return stat(arg, &info) == 0 && info.st_size > 0;
+  case 'L':
+  case 'h':
+    return lstat(arg, &info) == 0 && S_ISLNK(info.st_mode);
+  case 'r':
+    return access(arg, R_OK) == 0;
+  case 'w':
+    return access(arg, W_OK) == 0;
+  case 'x':
+    return access(arg, X_OK) == 0;
+  }
+  return -1;
+}
+
+/// Evaluate a binary test, like `a = b`, returning -1 for an unknown operator.
+///
+/// Invalid numbers return -2.
+static int test_binary(FILE *err, char const *left, char const *op,
+                       char const *right) {
+  if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) {
+    return strcmp(left, right) == 0;
+  }
+  if (strcmp(op, "!=") == 0) {
+    return strcmp(left, right) != 0;
+  }
+  static char const *const ops[] = {"-eq", "-ne", "-lt", "-le", "-gt", "-ge"};
+  for (int i = 0; i < 6; ++i) {
+    if (strcmp(op, ops[i]) != 0) {
+      continue;
+    }
+    long long a;
+    long long b;
+    if (!test_number(err, left, &a) || !test_number(err, right, &b)) {
+      return -2;
+    }
+    bool results[] = {a == b, a != b, a < b, a <= b, a > b, a >= b};
+    return results[i];
+  }
+  return -1;
+}
+
+/// Evaluate a test expression, following the rules POSIX gives for each
+/// number of arguments.
+///
+/// This returns 1 if the test is true, 0 if false, and negative on errors.
+static int test_eval(FILE *err, int argc, char **argv) {
+  switch (argc) {
+  case 0:
+    return 0;
+  case 1:
+    return argv[0][0] != 0;
+  case 2: {
+    if (strcmp(argv[0], "!") == 0) {
+      int result = test_eval(err, 1, argv + 1);
+      return result < 0 ? result : !result;
+    }
+    return test_unary(argv[0], argv[1]);
+  }
+  case 3: {
+    int result = test_binary(err, argv[0], argv[1], argv[2]);
+    if (result != -1) {
+      return result;
+    }
+    if (strcmp(argv[0], "!") == 0) {
+      result = test_eval(err, 2, argv + 1);
+      return result < 0 ? result : !result;
+    }
+    if (strcmp(argv[0], "(") == 0 && strcmp(argv[2], ")") == 0) {
+      return test_eval(err, 1, argv + 1);
+    }
+    return -1;
+  }
+  case 4: {
+    if (strcmp(argv[0], "!") == 0) {
+      int result = test_eval(err, 3, argv + 1);
+      return result < 0 ? result : !result;
+    }
+    if (strcmp(argv[0], "(") == 0 && strcmp(argv[3], ")") == 0) {
+      return test_eval(err, 2, argv + 1);
+    }
+    return -1;
+  }
+  }
+  return -1;
+}
+
+static int run_test(FILE *err, char const *name, int argc, char **argv) {
+  int result = test_eval(err, argc, argv);
+  if (result == -1) {
+    fprintf(err, "%s: syntax error\n", name);
+  }
+  if (result < 0) {
+    return 2;
+  }
+  return result ? 0 : 1;
+}
+
+static int builtin_test(BuiltinEnv *env, char **argv) {
+  int argc = 0;
+  for (; argv[argc + 1] != NULL; ++argc) {
+  }
+  return run_test(env->err, "test", argc, argv + 1);
+}
+
+static int builtin_bracket(BuiltinEnv *env, char **argv) {
+  int argc = 0;
+  for (; argv[argc + 1] != NULL; ++argc) {
+  }
+  if (argc == 0 || strcmp(argv[argc], "]") != 0) {
+    fputs("[: missing ]\n", env->err);
+    return 2;
+  }
+  return run_test(env->err, "[", argc - 1, argv + 1);
+}
+
+static int builtin_true(BuiltinEnv *env, char **argv) {
+  (void)env;
+  (void)argv;
+  return 0;
+}
+
+static int builtin_false(BuiltinEnv *env, char **argv) {
+  (void)env;
+  (void)argv;
+  return 1;
+}
+
+static int builtin_stats(BuiltinEnv *env, char **argv) {
+  if (argv[1] != NULL && strcmp(argv[1], "-r") == 0) {
+    stats_reset();
+    return 0;
+  }
+  if (argv[1] != NULL) {
+    fprintf(env->err, "stats: usage: stats [-r]\n");
+    return 2;
+  }
+  stats_print(env->out);
+  return 0;
+}
+
+static const BuiltinSpec BUILTINS[BUILTIN_COUNT] = {
+    [BUILTIN_PWD] = {"pwd", builtin_pwd},
+    [BUILTIN_CD] = {"cd", builtin_cd},
+    [BUILTIN_HASH] = {"hash", interpreter_builtin_hash},
+    [BUILTIN_ECHO] = {"echo", builtin_echo},
+    [BUILTIN_PRINTF] = {"printf", builtin_printf},
+    [BUILTIN_TEST] = {"test", builtin_test},
+    [BUILTIN_BRACKET] = {"[", builtin_bracket},
+    [BUILTIN_TRUE] = {"true", builtin_true},
+    [BUILTIN_FALSE] = {"false", builtin_false},
+    [BUILTIN_COLON] = {":", builtin_true},
+    [BUILTIN_PIPESTATUS] = {"pipestatus", interpreter_builtin_pipestatus},
+    [BUILTIN_STATS] = {"stats", builtin_stats},
+    [BUILTIN_JOBS] = {"jobs", interpreter_builtin_jobs},
+    [BUILTIN_WAIT] = {"wait", interpreter_builtin_wait},
+    [BUILTIN_PARALLEL] = {"parallel", interpreter_builtin_parallel},
+    [BUILTIN_EXPORT] = {"export", interpreter_builtin_export},
+    [BUILTIN_UNSET] = {"unset", interpreter_builtin_unset},
+};
+
+/// The number of slots in the hash table of builtins.
+#define BUILTIN_SLOTS 64
+
+/// Hash the name of a builtin, from its length, first and last characters.
+///
+/// This is a perfect hash for the names of our builtins. Since the table
+/// below is filled in with designated initializers, a collision overrides
+/// an earlier entry, which `-Woverride-init` turns into a build error.
+#define BUILTIN_HASH(len, first, last)                                         \
+  (((len) + (unsigned char)(first) + (unsigned char)(last)) % BUILTIN_SLOTS)
+
+/// For each slot in the table, the builtin stored there, plus one.
+static const uint8_t BUILTIN_TABLE[BUILTIN_SLOTS] = {
+    [BUILTIN_HASH(3, 'p', 'd')] = BUILTIN_PWD + 1,
+    [BUILTIN_HASH(2, 'c', 'd')] = BUILTIN_CD + 1,
+    [BUILTIN_HASH(4, 'h', 'h')] = BUILTIN_HASH + 1,
+    [BUILTIN_HASH(4, 'e', 'o')] = BUILTIN_ECHO + 1,
+    [BUILTIN_HASH(6, 'p', 'f')] = BUILTIN_PRINTF + 1,
+    [BUILTIN_HASH(4, 't', 't')] = BUILTIN_TEST + 1,
+    [BUILTIN_HASH(1, '[', '[')] = BUILTIN_BRACKET + 1,
+    [BUILTIN_HASH(4, 't', 'e')] = BUILTIN_TRUE + 1,
+    [BUILTIN_HASH(5, 'f', 'e')] = BUILTIN_FALSE + 1,
+    [BUILTIN_HASH(1, ':', ':')] = BUILTIN_COLON + 1,
+    [BUILTIN_HASH(10, 'p', 's')] = BUILTIN_PIPESTATUS + 1,
+    [BUILTIN_HASH(5, 's', 's')] = BUILTIN_STATS + 1,
+    [BUILTIN_HASH(4, 'j', 's')] = BUILTIN_JOBS + 1,
+    [BUILTIN_HASH(4, 'w', 't')] = BUILTIN_WAIT + 1,
+    [BUILTIN_HASH(8, 'p', 'l')] = BUILTIN_PARALLEL + 1,
+    [BUILTIN_HASH(6, 'e', 't')] = BUILTIN_EXPORT + 1,
+    [BUILTIN_HASH(5, 'u', 't')] = BUILTIN_UNSET + 1,
+};
+
+bool builtin_lookup(StringSlice name, Builtin *out) {
+  if (name.len == 0) {
+    return false;
+  }
+  uint8_t entry = BUILTIN_TABLE[BUILTIN_HASH(name.len, name.data[0],
+                                             name.data[name.len - 1])];
+  if (entry == 0) {
+    return false;
+  }
+  char const *candidate = BUILTINS[entry - 1].name;
+  if (strlen(candidate) != name.len ||
+      memcmp(candidate, name.data, name.len) != 0) {
+    return false;
+  }
+  *out = entry - 1;
+  return true;
+}
+
+BuiltinSpec const *builtin_spec(Builtin builtin) {
+  return BUILTINS + builtin;
+}
@@ -0,0 +1,219 @@
+#include "errno.h"
+#include "fcntl.h"
+#include "limits.h"
+#include "stdint.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "unistd.h"
+
+#include "include/bytecode_cache.h"
+
+/// The version of the cache format.
+///
+/// This needs to be bumped whenever the meaning of operations changes.
+const uint32_t BYTECODE_VERSION = 10;
+
+static char const BYTECODE_MAGIC[8] = "SALLYBC";
+
+/// The header at the start of each cache file.
+///
+/// The operations come right after this, followed by the arena contents.
+typedef struct BytecodeHeader {
+  char magic[8];
+  uint32_t version;
+  /// The size of an operation, which catches layout changes between builds.
+  uint32_t op_size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t source_len;
+  uint64_t source_hash;
+  uint64_t op_count;
+  uint64_t arena_len;
+} BytecodeHeader;
+
+bool bytecode_cache_enabled() {
+  char const *value = getenv("SALLY_BYTECODE_CACHE");
+  return value == NULL || strcmp(value, "0") != 0;
+}
+
+/// FNV-1a, used both to name cache files, and to check their contents.
+static uint64_t hash_bytes(StringSlice slice) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < slice.len; ++i) {
+    hash ^= (unsigned char)slice.data[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+/// Find the directory holding the cache, returning false if there's none.
+static bool cache_dir(char *buf, size_t len) {
+  char const *xdg = getenv("XDG_CACHE_HOME");
+  if (xdg != NULL && xdg[0] != 0) {
+    return (size_t)snprintf(buf, len, "%s/sally", xdg) < len;
+  }
+  char const *home = getenv("HOME");
+  if (home == NULL || home[0] == 0) {
+    return false;
+  }
+  return (size_t)snprintf(buf, len, "%s/.cache/sally", home) < len;
+}
+
+/// Find the file a script would be cached in, returning false if there's none.
+static bool cache_file(char const *path, char *buf, size_t len) {
+  char dir[PATH_MAX];
+  char resolved[PATH_MAX];
+  if (!cache_dir(dir, PATH_MAX) || realpath(path, resolved) == NULL) {
+    return false;
+  }
+  uint64_t key = hash_bytes((StringSlice){resolved, strlen(resolved)});
+  return (size_t)snprintf(buf, len, "%s/%016llx.sbc", dir,
+                          (unsigned long long)key) < len;
+}
+
+static BytecodeHeader header_for(Script *script) {
+  BytecodeHeader header;
+  memset(&header, 0, sizeof(BytecodeHeader));
+  memcpy(header.magic, BYTECODE_MAGIC, sizeof(BYTECODE_MAGIC));
+  header.version = BYTECODE_VERSION;
+  header.op_size = sizeof(Op);
+  header.mtime_sec = script->mtime.tv_sec;
+  header.mtime_nsec = script->mtime.tv_nsec;
+  header.source_len = script->source.len;
+  return header;
+}
+
+bool bytecode_cache_load(char const *path, Script *script, StringArena *arena,
+                         BytecodeCacheEntry *out) {
+  char file[PATH_MAX];
+  if (!cache_file(path, file, PATH_MAX)) {
+    return false;
+  }
+  int fd = open(file, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(BytecodeHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t map_len = info.st_size;
+  void *map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  // Cheap checks first, so that we only hash the script if we have to.
+  BytecodeHeader const *header = map;
+  BytecodeHeader expected = header_for(script);
+  if (memcmp(header->magic, expected.magic, sizeof(expected.magic)) != 0 ||
+      header->version != expected.version ||
+      header->op_size != expected.op_size ||
+      header->mtime_sec != expected.mtime_sec ||
+      header->mtime_nsec != expected.mtime_nsec ||
+      header->source_len != expected.source_len ||
+      header->op_count > map_len / sizeof(Op) ||
+      sizeof(BytecodeHeader) + header->op_count * sizeof(Op) +
+              header->arena_len !=
+          map_len ||
+      header->source_hash != hash_bytes(script->source)) {
+    munmap(map, map_len);
+    return false;
+  }
+
+  char const *ops = (char const *)map + sizeof(BytecodeHeader);
+  size_t ops_len = header->op_count * sizeof(Op);
+  string_arena_load(arena,
+                    (StringSlice){.data = ops + ops_len,
+                                  .len = header->arena_len});
+  out->map = map;
+  out->map_len = map_len;
+  out->ops = (OpBuffer){.ops = (Op *)ops,
+                        .len = header->op_count,
+                        .capacity = header->op_count};
+  return true;
+}
+
+void bytecode_cache_close(BytecodeCacheEntry *entry) {
+  munmap(entry->map, entry->map_len);
+}
+
+/// Create a directory, along with any missing parents.
+static int make_dirs(char *dir) {
+  for (char *slash = strchr(dir + 1, '/');; slash = strchr(slash + 1, '/')) {
+    if (slash != NULL) {
+      *slash = 0;
+    }
+    int result = mkdir(dir, 0700);
+    if (slash != NULL) {
+      *slash = '/';
+    }
+    if (result == -1 && errno != EEXIST) {
+      return -1;
+    }
+    if (slash == NULL) {
+      return 0;
+    }
+  }
+}
+
+/// Write an entire buffer to a file, retrying on partial writes.
+static int write_all(int fd, void const *data, size_t len) {
+  char const *at = data;
+  while (len > 0) {
+    ssize_t count = write(fd, at, len);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    at += count;
+    len -= count;
+  }
+  return 0;
+}
+
+Error bytecode_cache_store(char const *path, Script *script, StringArena *arena,
+                           OpBuffer *ops) {
+  char dir[PATH_MAX];
+  char file[PATH_MAX];
+  char tmp[PATH_MAX];
+  if (!cache_dir(dir, PATH_MAX) || !cache_file(path, file, PATH_MAX) ||
+      (size_t)snprintf(tmp, PATH_MAX, "%s.%d.tmp", file, (int)getpid()) >=
+          PATH_MAX) {
+    return error_from_errno(ENAMETOOLONG);
+  }
+  if (make_dirs(dir) == -1) {
+    return error_from_errno(errno);
+  }
+
+  StringSlice contents = string_arena_contents(arena);
+  BytecodeHeader header = header_for(script);
+  header.source_hash = hash_bytes(script->source);
+  header.op_count = ops->len;
+  header.arena_len = contents.len;
+
+  // Writing to a temporary file first means readers never see half an entry.
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    return error_from_errno(errno);
+  }
+  if (write_all(fd, &header, sizeof(BytecodeHeader)) == -1 ||
+      write_all(fd, ops->ops, ops->len * sizeof(Op)) == -1 ||
+      write_all(fd, contents.data, contents.len) == -1) {
+    int errnum = errno;
+    close(fd);
+    unlink(tmp);
+    return error_from_errno(errnum);
+  }
+  close(fd);
+  if (rename(tmp, file) == -1) {
+    int errnum = errno;
+    unlink(tmp);
+    return error_from_errno(errnum);
+  }
+  return (Error){ERROR_NONE};
+}
@@ -0,0 +1,227 @@
+#include "limits.h"
+#include "stdbool.h"
+#include "stdint.h"
+#include "stdlib.h"
+#include "string.h"
+#include "sys/stat.h"
+#include "unistd.h"
+
+#include "include/command_cache.h"
+#include "include/error.h"
+
+/// The search path used when `$PATH` isn't set, matching `execvp`.
+static char const *DEFAULT_PATH = "/bin:/usr/bin";
+
+typedef struct CommandCacheEntry {
+  /// The name of the command, or NULL if this slot is empty.
+  char *name;
+  /// The absolute path this command resolved to.
+  char *path;
+  /// The number of times this entry has been used.
+  size_t hits;
+  /// Set for slots whose entry was removed, so that probing continues past them.
+  bool tombstone;
+} CommandCacheEntry;
+
+struct CommandCache {
+  CommandCacheEntry *entries;
+  /// The number of slots in entries, always a power of 2.
+  size_t capacity;
+  /// The number of slots which are either full, or tombstones.
+  size_t used;
+  /// A copy of the path commands are searched for in.
+  char *path_env;
+  size_t hits;
+  size_t misses;
+};
+
+const size_t COMMAND_CACHE_START_CAPACITY = 64;
+
+CommandCache *command_cache_init() {
+  CommandCache *out = malloc(sizeof(CommandCache));
+  if (out == NULL) {
+    panic("command_cache_init: failed to allocate memory");
+  }
+  out->capacity = COMMAND_CACHE_START_CAPACITY;
+  out->entries = calloc(out->capacity, sizeof(CommandCacheEntry));
+  if (out->entries == NULL) {
+    panic("command_cache_init: failed to allocate memory");
+  }
+  out->used = 0;
+  out->path_env = strdup(DEFAULT_PATH);
+  if (out->path_env == NULL) {
+    panic("command_cache_init: failed to allocate memory");
+  }
+  out->hits = 0;
+  out->misses = 0;
+  return out;
+}
+
+void command_cache_clear(CommandCache *cache) {
+  for (size_t i = 0; i < cache->capacity; ++i) {
+    CommandCacheEntry *entry = cache->entries + i;
+    free(entry->name);
+    free(entry->path);
+    *entry = (CommandCacheEntry){NULL, NULL, 0, false};
+  }
+  cache->used = 0;
+  // The counters only describe the entries that are left.
+  cache->hits = 0;
+  cache->misses = 0;
+}
+
+void command_cache_free(CommandCache *cache) {
+  command_cache_clear(cache);
+  free(cache->entries);
+  free(cache->path_env);
+  free(cache);
+}
+
+/// FNV-1a, which is plenty for short command names.
+static uint64_t hash_name(char const *name) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (; *name != 0; ++name) {
+    hash ^= (unsigned char)*name;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+/// Find the slot for a name.
+///
+/// This returns either the slot containing that name, or the empty slot where
+/// it should be inserted.
+static CommandCacheEntry *command_cache_slot(CommandCache *cache,
+                                             char const *name) {
+  size_t mask = cache->capacity - 1;
+  CommandCacheEntry *insert = NULL;
+  for (size_t i = hash_name(name) & mask;; i = (i + 1) & mask) {
+    CommandCacheEntry *entry = cache->entries + i;
+    if (entry->name == NULL) {
+      if (!entry->tombstone) {
+        return insert != NULL ? insert : entry;
+      }
+      if (insert == NULL) {
+        insert = entry;
+      }
+    } else if (strcmp(entry->name, name) == 0) {
+      return entry;
+    }
+  }
+}
+
+static void command_cache_grow(CommandCache *cache) {
+  CommandCacheEntry *old = cache->entries;
+  size_t old_capacity = cache->capacity;
+
+  cache->capacity *= 2;
+  cache->entries = calloc(cache->capacity, sizeof(CommandCacheEntry));
+  if (cache->entries == NULL) {
+    panic("command_cache: failed to allocate memory");
+  }
+  cache->used = 0;
+  for (size_t i = 0; i < old_capacity; ++i) {
+    if (old[i].name != NULL) {
+      *command_cache_slot(cache, old[i].name) = old[i];
+      cache->used++;
+    }
+  }
+  free(old);
+}
+
+/// Search through each directory in path for an executable with a given name.
+///
+/// The result is allocated with malloc, and is NULL if nothing is found.
+static char *resolve(char const *path, char const *name) {
+  char buf[PATH_MAX];
+  size_t name_len = strlen(name);
+  for (char const *dir = path;; ++dir) {
+    char const *end = strchr(dir, ':');
+    size_t dir_len = end == NULL ? strlen(dir) : (size_t)(end - dir);
+    // An empty entry in the path means the current directory.
+    if (dir_len == 0) {
+      dir = ".";
+      dir_len = 1;
+    }
+    if (dir_len + name_len + 2 <= PATH_MAX) {
+      memcpy(buf, dir, dir_len);
+      buf[dir_len] = '/';
+      memcpy(buf + dir_len + 1, name, name_len + 1);
+
+      struct stat info;
+      if (stat(buf, &info) == 0 && S_ISREG(info.st_mode) &&
+          access(buf, X_OK) == 0) {
+        return strdup(buf);
+      }
+    }
+    if (end == NULL) {
+      return NULL;
+    }
+    dir = end;
+  }
+}
+
+void command_cache_set_path(CommandCache *cache, char const *path) {
+  if (path == NULL) {
+    path = DEFAULT_PATH;
+  }
+  if (strcmp(cache->path_env, path) == 0) {
+    return;
+  }
+  command_cache_clear(cache);
+  free(cache->path_env);
+  cache->path_env = strdup(path);
+  if (cache->path_env == NULL) {
+    panic("command_cache: failed to allocate memory");
+  }
+}
+
+char const *command_cache_lookup(CommandCache *cache, char const *name) {
+  if (strchr(name, '/') != NULL) {
+    return name;
+  }
+
+  CommandCacheEntry *entry = command_cache_slot(cache, name);
+  if (entry->name != NULL) {
+    cache->hits++;
+    entry->hits++;
+    return entry->path;
+  }
+
+  cache->misses++;
+  char *resolved = resolve(cache->path_env, name);
+  if (resolved == NULL) {
+    return NULL;
+  }
+  if (!entry->tombstone) {
+    cache->used++;
+  }
+  *entry = (CommandCacheEntry){strdup(name), resolved, 1, false};
+  // Keep the table at most half full, so that probe sequences stay short.
+  if (2 * cache->used > cache->capacity) {
+    command_cache_grow(cache);
+    return command_cache_slot(cache, name)->path;
+  }
+  return resolved;
+}
+
+void command_cache_forget(CommandCache *cache, char const *name) {
+  CommandCacheEntry *entry = command_cache_slot(cache, name);
+  if (entry->name == NULL) {
+    return;
+  }
+  free(entry->name);
+  free(entry->path);
+  *entry = (CommandCacheEntry){NULL, NULL, 0, true};
+}
+
+void command_cache_print(CommandCache *cache, FILE *out) {
+  fputs("hits\tcommand\n", out);
+  for (size_t i = 0; i < cache->capacity; ++i) {
+    CommandCacheEntry *entry = cache->entries + i;
+    if (entry->name != NULL) {
+      fprintf(out, "%4zu\t%s\n", entry->hits, entry->path);
+    }
+  }
+  fprintf(out, "%zu hits, %zu misses\n", cache->hits, cache->misses);
+}
@@ -1,7 +1,23 @@
-#include "sys/types.h"
+#include "string.h"
 
 #include "include/compiler.h"
 
+extern inline bool op_is_builtin(OpType type);
+extern inline bool op_is_command(OpType type);
+extern inline RedirectTable const *op_redirects(char **argv,
+                                               size_t arg_count);
+extern inline ExpansionTable const *op_expansions(char **argv,
+                                                  size_t arg_count,
+                                                  OpFlag flag);
+extern inline size_t op_table_count(OpFlag flag);
+extern inline OverlayTable const *op_overlay(char **argv, size_t arg_count,
+                                             OpFlag flag);
+extern inline char **op_bindings(char **argv, size_t arg_count, OpFlag flag);
+extern inline bool redirect_opens_file(RedirectType type);
+extern inline bool redirect_has_string(RedirectType type);
+extern inline bool redirect_reads_string(RedirectType type);
+extern inline int redirect_open_flags(RedirectType type);
+
 void op_buffer_push(OpBuffer *buf, Op op) {
   size_t required = buf->len + 1;
   if (required > buf->capacity) {
@@ -13,94 +29,762 @@ void op_buffer_push(OpBuffer *buf, Op op) {
     if (new_ops == NULL) {
       panic("compiler: failed to allocate memory for opcodes");
     }
+    buf->ops = new_ops;
     buf->capacity = new_capacity;
   }
   buf->ops[buf->len++] = op;
 }
 
 const size_t OP_BUFFER_START_SIZE = 2048;
+const size_t OP_BUFFER_ARGS_START_SIZE = 16;
+const size_t OP_BUFFER_REDIRECTS_START_SIZE = 4;
+const size_t OP_BUFFER_PARTS_START_SIZE = 8;
+const size_t OP_BUFFER_ASSIGNMENTS_START_SIZE = 4;
 
 OpBuffer *op_buffer_init() {
   OpBuffer *out = malloc(sizeof(OpBuffer));
   out->ops = malloc(sizeof(Op) * OP_BUFFER_START_SIZE);
-  if (out->ops == NULL) {
+  out->args = malloc(sizeof(StringHandle) * OP_BUFFER_ARGS_START_SIZE);
+  out->redirects = malloc(sizeof(Redirect) * OP_BUFFER_REDIRECTS_START_SIZE);
+  out->parts = malloc(sizeof(ExpansionPart) * OP_BUFFER_PARTS_START_SIZE);
+  out->assignments =
+      malloc(sizeof(Assignment) * OP_BUFFER_ASSIGNMENTS_START_SIZE);
+  if (out->ops == NULL || out->args == NULL || out->redirects == NULL ||
+      out->parts == NULL || out->assignments == NULL) {
     panic("op_buffer_init: failed to allocate memory");
   }
   out->len = 0;
   out->capacity = OP_BUFFER_START_SIZE;
+  out->args_len = 0;
+  out->args_capacity = OP_BUFFER_ARGS_START_SIZE;
+  out->redirects_len = 0;
+  out->redirects_capacity = OP_BUFFER_REDIRECTS_START_SIZE;
+  out->parts_len = 0;
+  out->parts_capacity = OP_BUFFER_PARTS_START_SIZE;
+  out->bindings_len = 0;
+  out->assignments_len = 0;
+  out->assignments_capacity = OP_BUFFER_ASSIGNMENTS_START_SIZE;
 
   return out;
 }
 
 void op_buffer_reset(OpBuffer *buf) {
   buf->len = 0;
+  buf->args_len = 0;
+  buf->redirects_len = 0;
+  buf->parts_len = 0;
+  buf->bindings_len = 0;
+  buf->assignments_len = 0;
 }
 
 void op_buffer_free(OpBuffer *buf) {
   free(buf->ops);
+  free(buf->args);
+  free(buf->redirects);
+  free(buf->parts);
+  free(buf->assignments);
   free(buf);
 }
 
-Error handle_node(ASTNode *input, OpFlag flag, OpBuffer *out) {
+/// Gather an argument for the command being compiled.
+static void push_arg(OpBuffer *out, StringHandle string) {
+  if (out->args_len >= out->args_capacity) {
+    out->args_capacity *= 2;
+    out->args =
+        realloc(out->args, sizeof(StringHandle) * out->args_capacity);
+    if (out->args == NULL) {
+      panic("compiler: failed to allocate memory for arguments");
+    }
+  }
+  out->args[out->args_len++] = string;
+}
+
+/// Gather a piece of a word containing substitutions.
+static void push_part(OpBuffer *out, ExpansionPart part) {
+  if (out->parts_len >= out->parts_capacity) {
+    out->parts_capacity *= 2;
+    out->parts =
+        realloc(out->parts, sizeof(ExpansionPart) * out->parts_capacity);
+    if (out->parts == NULL) {
+      panic("compiler: failed to allocate memory for substitutions");
+    }
+  }
+  out->parts[out->parts_len++] = part;
+}
+
+/// Gather the substitutions of a template, as described for
+/// `TOKEN_EXPANSION`, for the word at an index in argv.
+///
+/// The text and names of the parts point into the template, so nothing else
+/// gets allocated for them.
+static void push_parts(OpBuffer *out, StringArena *arena, StringHandle string,
+                       size_t arg) {
+  char const *start = string_arena_get_str(arena, string);
+  for (char const *at = start;;) {
+    size_t text_len = strlen(at);
+    char const *name = at + text_len + 1;
+    size_t name_len = strlen(name);
+    StringHandle name_handle =
+        name_len == 0 ? STRING_HANDLE_NULL : string + (name - start);
+    push_part(out, (ExpansionPart){.arg = arg,
+                                   .text = {.handle = string + (at - start)},
+                                   .text_len = text_len,
+                                   .variable = {.name = name_handle,
+                                                .symbol = SYMBOL_NONE}});
+    if (name_len == 0) {
+      return;
+    }
+    at = name + name_len + 1;
+  }
+}
+
+/// Gather a word for the command being compiled, along with its
+/// substitutions, if it's a template, as described for `TOKEN_EXPANSION`.
+static void push_word(OpBuffer *out, StringArena *arena, StringHandle string,
+                      bool expansion) {
+  push_arg(out, string);
+  if (expansion) {
+    push_parts(out, arena, string, out->args_len - 1);
+  }
+}
+
+/// Gather a redirect for the command being compiled.
+///
+/// The template of a here-document or here-string with substitutions gets
+/// its own table of them, laid out in the arena, since it isn't in argv.
+static void push_redirect(OpBuffer *out, StringArena *arena,
+                          Redirect redirect) {
+  if (redirect.type == REDIRECT_TEMPLATE) {
+    size_t start = out->parts_len;
+    push_parts(out, arena, redirect.data.handle, 0);
+    size_t size = sizeof(ExpansionPart) * (out->parts_len - start);
+    StringHandle handle =
+        string_arena_reserve(arena, sizeof(ExpansionTable) + size);
+    ExpansionTable *table = string_arena_get_data(arena, handle);
+    table->count = out->parts_len - start;
+    memcpy(table->parts, out->parts + start, size);
+    out->parts_len = start;
+    redirect.data.handle = handle;
+  }
+  if (out->redirects_len >= out->redirects_capacity) {
+    out->redirects_capacity *= 2;
+    out->redirects =
+        realloc(out->redirects, sizeof(Redirect) * out->redirects_capacity);
+    if (out->redirects == NULL) {
+      panic("compiler: failed to allocate memory for redirects");
+    }
+  }
+  out->redirects[out->redirects_len++] = redirect;
+}
+
+/// Gather an assignment at the start of a command.
+static void push_assignment(OpBuffer *out, Assignment assignment) {
+  if (out->assignments_len >= out->assignments_capacity) {
+    out->assignments_capacity *= 2;
+    out->assignments = realloc(out->assignments,
+                               sizeof(Assignment) * out->assignments_capacity);
+    if (out->assignments == NULL) {
+      panic("compiler: failed to allocate memory for assignments");
+    }
+  }
+  out->assignments[out->assignments_len++] = assignment;
+}
+
+/// The size of a template, as described for `TOKEN_EXPANSION`, including the
+/// empty name ending it.
+static size_t template_size(char const *template) {
+  char const *at = template;
+  for (;;) {
+    at += strlen(at) + 1;
+    size_t name_len = strlen(at);
+    at += name_len + 1;
+    if (name_len == 0) {
+      return at - template;
+    }
+  }
+}
+
+/// Gather the `NAME=value` binding of an assignment, for the environment of
+/// the command being compiled, before any of its words.
+///
+/// A value with substitutions stays a template, whose first text starts with
+/// the name, so the binding gets expanded like any other word.
+static void push_binding(OpBuffer *out, StringArena *arena,
+                         Assignment assignment) {
+  size_t name_len = strlen(string_arena_get_str(arena, assignment.name));
+  char const *value = string_arena_get_str(arena, assignment.value);
+  size_t value_size =
+      assignment.expansion ? template_size(value) : strlen(value) + 1;
+  StringHandle binding =
+      string_arena_reserve(arena, name_len + 1 + value_size);
+  // Reserving can move the arena, so the strings are only fetched after.
+  char *at = string_arena_get_data(arena, binding);
+  memcpy(at, string_arena_get_str(arena, assignment.name), name_len);
+  at[name_len] = '=';
+  memcpy(at + name_len + 1, string_arena_get_str(arena, assignment.value),
+         value_size);
+  push_word(out, arena, binding, assignment.expansion);
+  out->bindings_len++;
+}
+
+/// Move the arguments gathered so far into the arena, as the argv of a
+/// command, which ends with NULL, and then a table of the redirects gathered,
+/// if any, which adds `OP_FLAG_REDIRECT` to its flags, a table of the
+/// substitutions, which adds `OP_FLAG_EXPAND`, and a table of the bindings,
+/// which adds `OP_FLAG_OVERLAY`, followed by the bindings themselves.
+static StringHandle finish_argv(OpBuffer *out, StringArena *arena,
+                                OpFlag *flag) {
+  // Bindings were gathered before the words of the command, but go after its
+  // tables, so that its argv starts with its name.
+  size_t bindings = out->bindings_len;
+  size_t head = out->args_len - bindings + 1 + (out->redirects_len > 0) +
+                (out->parts_len > 0) + (bindings > 0);
+  for (size_t i = 0; i < out->parts_len; ++i) {
+    size_t *arg = &out->parts[i].arg;
+    *arg = *arg < bindings ? head + *arg : *arg - bindings;
+  }
+  push_arg(out, STRING_HANDLE_NULL);
+  if (out->redirects_len > 0) {
+    size_t size = sizeof(Redirect) * out->redirects_len;
+    StringHandle handle =
+        string_arena_reserve(arena, sizeof(RedirectTable) + size);
+    RedirectTable *table = string_arena_get_data(arena, handle);
+    table->count = out->redirects_len;
+    memcpy(table->redirects, out->redirects, size);
+    push_arg(out, handle);
+    *flag |= OP_FLAG_REDIRECT;
+  }
+  if (out->parts_len > 0) {
+    size_t size = sizeof(ExpansionPart) * out->parts_len;
+    StringHandle handle =
+        string_arena_reserve(arena, sizeof(ExpansionTable) + size);
+    ExpansionTable *table = string_arena_get_data(arena, handle);
+    table->count = out->parts_len;
+    memcpy(table->parts, out->parts, size);
+    push_arg(out, handle);
+    *flag |= OP_FLAG_EXPAND;
+  }
+  if (bindings > 0) {
+    StringHandle handle = string_arena_reserve(
+        arena, sizeof(OverlayTable) + sizeof(Symbol) * bindings);
+    OverlayTable *table = string_arena_get_data(arena, handle);
+    table->count = bindings;
+    for (size_t i = 0; i < bindings; ++i) {
+      table->symbols[i] = SYMBOL_NONE;
+    }
+    push_arg(out, handle);
+    for (size_t i = 0; i < bindings; ++i) {
+      push_arg(out, out->args[i]);
+    }
+    push_arg(out, STRING_HANDLE_NULL);
+    *flag |= OP_FLAG_OVERLAY;
+  }
+  StringHandle argv = string_arena_alloc_argv(arena, out->args + bindings,
+                                              out->args_len - bindings);
+  out->args_len = 0;
+  out->redirects_len = 0;
+  out->parts_len = 0;
+  out->bindings_len = 0;
+  return argv;
+}
+
+/// Emit a builtin, with the arguments gathered after a placeholder name.
+static void emit_builtin(OpBuffer *out, StringArena *arena, OpFlag flag,
+                         Builtin builtin) {
+  size_t arg_count = out->args_len - out->bindings_len - 1;
+  StringHandle argv = finish_argv(out, arena, &flag);
+  OpType type = flag == OP_FLAG_NONE ? OP_BUILTIN_PLAIN : OP_BUILTIN;
+  op_buffer_push(out, (Op){type,
+                           flag,
+                           {.builtin = {.builtin = builtin,
+                                        .arg_count = arg_count,
+                                        .argv = argv}}});
+}
+
+/// Emit a command, whose name is the first argument gathered.
+static void emit_command(OpBuffer *out, StringArena *arena, OpFlag flag) {
+  size_t arg_count = out->args_len - out->bindings_len - 1;
+  StringHandle argv = finish_argv(out, arena, &flag);
+  OpType type = flag == OP_FLAG_NONE ? OP_COMMAND_PLAIN : OP_COMMAND;
+  op_buffer_push(
+      out, (Op){type,
+                flag,
+                {.command = {.argv = argv, .arg_count = arg_count}}});
+}
+
+/// Emit an assignment to a variable, from a word.
+static void emit_assign(OpBuffer *out, StringArena *arena, OpFlag flag,
+                        Assignment assignment) {
+  StringHandle variable = string_arena_reserve(arena, sizeof(Variable));
+  *(Variable *)string_arena_get_data(arena, variable) =
+      (Variable){.name = assignment.name, .symbol = SYMBOL_NONE};
+  push_word(out, arena, assignment.value, assignment.expansion);
+  StringHandle argv = finish_argv(out, arena, &flag);
+  op_buffer_push(out, (Op){OP_ASSIGN,
+                           flag,
+                           {.assign = {.variable = variable, .argv = argv}}});
+}
+
+/// Emit the assignments gathered, as a command of their own.
+///
+/// Only the first assignment reads from a pipe, and the last writes to it.
+static void emit_assignments(OpBuffer *out, StringArena *arena, OpFlag flag) {
+  for (size_t i = 0; i < out->assignments_len; ++i) {
+    OpFlag assign_flag = flag;
+    if (i > 0) {
+      assign_flag &= ~OP_FLAG_CONTINUE_PIPE;
+    }
+    if (i + 1 < out->assignments_len) {
+      assign_flag &= ~OP_FLAG_START_PIPE;
+    }
+    emit_assign(out, arena, assign_flag, out->assignments[i]);
+  }
+  out->assignments_len = 0;
+}
+
+/// Gather the binding of each assignment gathered, for the command after
+/// them.
+static void push_bindings(OpBuffer *out, StringArena *arena) {
+  for (size_t i = 0; i < out->assignments_len; ++i) {
+    push_binding(out, arena, out->assignments[i]);
+  }
+  out->assignments_len = 0;
+}
+
+static void emit_wait(OpBuffer *out) {
+  op_buffer_push(out, (Op){OP_WAIT, OP_FLAG_NONE, {.target = 0}});
+}
+
+static void emit_background(OpBuffer *out) {
+  op_buffer_push(out, (Op){OP_BACKGROUND, OP_FLAG_NONE, {.target = 0}});
+}
+
+/// Emit a jump, whose target gets filled in later by `patch_jump`.
+///
+/// This returns the index of the jump.
+static size_t emit_jump(OpBuffer *out, OpType type) {
+  op_buffer_push(out, (Op){type, OP_FLAG_NONE, {.target = 0}});
+  return out->len - 1;
+}
+
+/// Make a jump go to the next operation to be emitted.
+static void patch_jump(OpBuffer *out, size_t jump) {
+  out->ops[jump].data.target = out->len;
+}
+
+/// The flags for the stage at index i of a pipeline with count stages.
+static OpFlag pipe_flag(size_t i, size_t count) {
+  OpFlag flag = OP_FLAG_NONE;
+  if (i > 0) {
+    flag |= OP_FLAG_CONTINUE_PIPE;
+  }
+  if (i + 1 < count) {
+    flag |= OP_FLAG_START_PIPE;
+  }
+  return flag;
+}
+
+static Error handle_statement(ASTNode *input, StringArena *arena,
+                              OpBuffer *out);
+
+/// Emit a builtin or a command, with the redirects gathered for it.
+static void handle_invocation(ASTNode *input, OpFlag flag, StringArena *arena,
+                              OpBuffer *out) {
+  // A command whose name has substitutions has it as its first child.
+  if (input->type == AST_BUILTIN || input->data.string != STRING_HANDLE_NULL) {
+    push_arg(out, input->type == AST_BUILTIN ? STRING_HANDLE_NULL
+                                             : input->data.string);
+  }
+  for (size_t i = 0; i < input->count; ++i) {
+    ASTNode *arg = input->children + i;
+    push_word(out, arena, arg->data.string, arg->type == AST_EXPANSION);
+  }
+  if (input->type == AST_BUILTIN) {
+    emit_builtin(out, arena, flag, input->data.builtin);
+  } else {
+    emit_command(out, arena, flag);
+  }
+}
+
+Error handle_node(ASTNode *input, OpFlag flag, StringArena *arena,
+                  OpBuffer *out) {
   switch (input->type) {
-  case AST_BUILTIN: {
-    for (ssize_t i = input->count - 1; i >= 0; i--) {
-      Error err = handle_node(input->children + i, OP_FLAG_NONE, out);
+  case AST_BUILTIN:
+  case AST_COMMAND: {
+    handle_invocation(input, flag, arena, out);
+    break;
+  }
+  case AST_ARG:
+  case AST_EXPANSION:
+  case AST_REDIRECTION:
+  case AST_VARIABLE: {
+    // Arguments, redirects, and variables are handled along with their
+    // command.
+    break;
+  }
+  case AST_ASSIGN:
+  case AST_OVERLAY: {
+    // An overlay has its command as its last child.
+    size_t count = input->type == AST_OVERLAY ? input->count - 1 : input->count;
+    for (size_t i = 0; i < count; ++i) {
+      ASTNode *value = input->children[i].children;
+      push_assignment(out,
+                      (Assignment){.name = input->children[i].data.string,
+                                   .value = value->data.string,
+                                   .expansion = value->type == AST_EXPANSION});
+    }
+    if (input->type == AST_ASSIGN) {
+      emit_assignments(out, arena, flag);
+      break;
+    }
+    push_bindings(out, arena);
+    return handle_node(input->children + count, flag, arena, out);
+  }
+  case AST_REDIRECT: {
+    for (size_t i = 1; i < input->count; ++i) {
+      push_redirect(out, arena, input->children[i].data.redirect);
+    }
+    handle_invocation(input->children, flag, arena, out);
+    break;
+  }
+  case AST_PIPE: {
+    for (size_t i = 0; i < input->count; ++i) {
+      Error err = handle_node(input->children + i, pipe_flag(i, input->count),
+                              arena, out);
       if (err.type != ERROR_NONE) {
         return err;
       }
     }
-    op_buffer_push(out, (Op){OP_BUILTIN, flag, {.builtin = input->builtin}});
     break;
   }
-  case AST_COMMAND: {
-    for (ssize_t i = input->count - 1; i >= 0; i--) {
-      Error err = handle_node(input->children + i, OP_FLAG_NONE, out);
+  case AST_SEQUENCE: {
+    for (size_t i = 0; i < input->count; ++i) {
+      Error err = handle_statement(input->children + i, arena, out);
       if (err.type != ERROR_NONE) {
         return err;
       }
     }
-    op_buffer_push(out, (Op){OP_COMMAND,
-                             flag,
-                             {.command = {.name = input->data.string,
-                                          .arg_count = input->count}}});
     break;
   }
-  case AST_ARG: {
-    op_buffer_push(out, (Op){OP_STRING, flag, {.string = input->data.string}});
+  case AST_BACKGROUND: {
+    Error err = handle_node(input->children, OP_FLAG_NONE, arena, out);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    emit_background(out);
     break;
   }
-  case AST_REDIRECT: {
-    op_buffer_push(
-        out, (Op){OP_STRING, flag, {.string = input->children[1].data.string}});
-    Error err = handle_node(input->children, OP_FLAG_REDIRECT, out);
+  case AST_AND:
+  case AST_OR: {
+    Error err = handle_statement(input->children, arena, out);
     if (err.type != ERROR_NONE) {
       return err;
     }
+    // The right side is skipped based on the status of the left side.
+    size_t jump = emit_jump(out, input->type == AST_AND ? OP_JUMP_IF_FAILURE
+                                                        : OP_JUMP_IF_SUCCESS);
+    err = handle_statement(input->children + 1, arena, out);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    patch_jump(out, jump);
     break;
   }
-  case AST_PIPE: {
-    for (size_t i = 0; i < input->count; ++i) {
-      OpFlag flag = OP_FLAG_NONE;
-      if (i > 0) {
-        flag |= OP_FLAG_CONTINUE_PIPE;
+  }
+  return (Error){ERROR_NONE};
+}
+
+/// Compile a statement, waiting for it to finish, unless it ends itself.
+static Error handle_statement(ASTNode *input, StringArena *arena,
+                              OpBuffer *out) {
+  Error err = handle_node(input, OP_FLAG_NONE, arena, out);
+  if (err.type != ERROR_NONE) {
+    return err;
+  }
+  // Background statements and lists of statements end themselves.
+  if (input->type != AST_BACKGROUND && input->type != AST_AND &&
+      input->type != AST_OR) {
+    emit_wait(out);
+  }
+  return (Error){ERROR_NONE};
+}
+
+Error compile(ASTNode *input, StringArena *arena, OpBuffer *out) {
+  return handle_node(input, OP_FLAG_NONE, arena, out);
+}
+
+/// Parse the assignments at the start of a command, starting with the name
+/// of the first one, and gathering each one.
+static Error direct_assignments(Parser *parser, OpBuffer *out) {
+  for (;;) {
+    Token name;
+    Error err = parse_peek(parser, &name);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    if (name.type != TOKEN_ASSIGNMENT) {
+      return (Error){ERROR_NONE};
+    }
+    parse_advance(parser);
+    // The lexer always follows an assignment with its value.
+    Token value;
+    if ((err = parse_peek(parser, &value)).type != ERROR_NONE) {
+      return err;
+    }
+    parse_advance(parser);
+    push_assignment(out,
+                    (Assignment){.name = name.data.string,
+                                 .value = value.data.string,
+                                 .expansion = value.type == TOKEN_EXPANSION});
+  }
+}
+
+/// Parse and emit a single command, with its arguments and redirects.
+///
+/// The operation is only emitted once the whole command has been parsed, so
+/// its flags can include whether or not a pipe follows, which this sets
+/// piped_out to.
+static Error direct_command(Parser *parser, OpFlag flag, OpBuffer *out,
+                            bool *piped_out) {
+  // A command which failed to parse might have left arguments behind.
+  out->args_len = 0;
+  out->redirects_len = 0;
+  out->parts_len = 0;
+  out->bindings_len = 0;
+  out->assignments_len = 0;
+  StringArena *arena = parser->lexer->arena;
+
+  Error err = direct_assignments(parser, out);
+  if (err.type != ERROR_NONE) {
+    return err;
+  }
+  Token head;
+  if ((err = parse_peek(parser, &head)).type != ERROR_NONE) {
+    return err;
+  }
+  if (head.type != TOKEN_BUILTIN && head.type != TOKEN_WORD &&
+      head.type != TOKEN_EXPANSION) {
+    if (out->assignments_len == 0) {
+      return (Error){ERROR_PARSER,
+                     {.parser_error = PARSER_ERROR_UNEXPECTED_TOKEN}};
+    }
+    // A command made only of assignments can't have redirects.
+    *piped_out = head.type == TOKEN_PIPE;
+    if (*piped_out) {
+      flag |= OP_FLAG_START_PIPE;
+    }
+    emit_assignments(out, arena, flag);
+    return (Error){ERROR_NONE};
+  }
+  parse_advance(parser);
+  // Assignments before a command are only for its environment.
+  push_bindings(out, arena);
+
+  push_word(out, arena,
+            head.type == TOKEN_BUILTIN ? STRING_HANDLE_NULL : head.data.string,
+            head.type == TOKEN_EXPANSION);
+  for (;;) {
+    bool is_word;
+    if ((err = parse_check_word(parser, &is_word)).type != ERROR_NONE) {
+      return err;
+    }
+    if (!is_word) {
+      break;
+    }
+    parse_advance(parser);
+    push_word(out, arena, parser->prev.data.string,
+              parser->prev.type == TOKEN_EXPANSION);
+  }
+
+  for (;;) {
+    Redirect redirect;
+    bool found;
+    if ((err = parse_redirect(parser, &found, &redirect)).type != ERROR_NONE) {
+      return err;
+    }
+    if (!found) {
+      break;
+    }
+    push_redirect(out, arena, redirect);
+  }
+
+  if ((err = parse_check(parser, TOKEN_PIPE, piped_out)).type != ERROR_NONE) {
+    return err;
+  }
+  if (*piped_out) {
+    flag |= OP_FLAG_START_PIPE;
+  }
+  if (head.type == TOKEN_BUILTIN) {
+    emit_builtin(out, arena, flag, head.data.builtin);
+  } else {
+    emit_command(out, arena, flag);
+  }
+  return (Error){ERROR_NONE};
+}
+
+/// Parse and emit a pipeline, made of commands separated by pipes.
+static Error direct_pipeline(Parser *parser, OpBuffer *out) {
+  OpFlag flag = OP_FLAG_NONE;
+  for (bool piped = true; piped; flag = OP_FLAG_CONTINUE_PIPE) {
+    Error err = direct_command(parser, flag, out, &piped);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    if (piped) {
+      parse_advance(parser);
+    }
+  }
+  return (Error){ERROR_NONE};
+}
+
+Error compile_direct(Parser *parser, OpBuffer *out) {
+  for (;;) {
+    bool eof;
+    Error err = parse_skip_newlines(parser, &eof);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    if (eof) {
+      return (Error){ERROR_NONE};
+    }
+
+    // Each `&&` or `||` jumps over the pipeline after it, to wherever the one
+    // after that starts, like the tree built by `parser_parse`.
+    bool has_jump = false;
+    size_t jump = 0;
+    Token peek;
+    for (;;) {
+      if ((err = direct_pipeline(parser, out)).type != ERROR_NONE) {
+        return err;
       }
-      if (i < input->count - 1) {
-        flag |= OP_FLAG_START_PIPE;
+      if ((err = parse_peek(parser, &peek)).type != ERROR_NONE) {
+        return err;
       }
-      Error err = handle_node(input->children + i, flag, out);
-      if (err.type != ERROR_NONE) {
+      if (peek.type != TOKEN_AND && peek.type != TOKEN_OR) {
+        break;
+      }
+      parse_advance(parser);
+      emit_wait(out);
+      if (has_jump) {
+        patch_jump(out, jump);
+      }
+      has_jump = true;
+      jump = emit_jump(out, peek.type == TOKEN_AND ? OP_JUMP_IF_FAILURE
+                                                   : OP_JUMP_IF_SUCCESS);
+      if ((err = parse_skip_newlines(parser, &eof)).type != ERROR_NONE) {
         return err;
       }
     }
-    break;
+
+    // Each statement needs to end with a line break, a semicolon, or the
+    // input, unless it runs in the background, in which case another
+    // statement can follow.
+    if (peek.type == TOKEN_AMPERSAND) {
+      if (has_jump) {
+        return (Error){ERROR_PARSER,
+                       {.parser_error = PARSER_ERROR_BACKGROUND_LIST}};
+      }
+      parse_advance(parser);
+      emit_background(out);
+      continue;
+    }
+    emit_wait(out);
+    if (has_jump) {
+      patch_jump(out, jump);
+    }
+    if (peek.type == TOKEN_SEMICOLON) {
+      parse_advance(parser);
+      continue;
+    }
+    if (peek.type != TOKEN_NEWLINE && peek.type != TOKEN_EOF) {
+      return (Error){ERROR_PARSER,
+                     {.parser_error = PARSER_ERROR_UNEXPECTED_TOKEN}};
+    }
   }
+}
+
+/// Find the symbol of a variable, from its name.
+static void link_variable(Variable *variable, StringArena *arena,
+                          SymbolTable *symbols) {
+  char const *name = string_arena_get_str(arena, variable->name);
+  variable->symbol = symbol_table_intern(
+      symbols, (StringSlice){.data = name, .len = strlen(name)});
+}
+
+/// Link the text and the variables of a table of substitutions.
+static void link_parts(ExpansionTable *table, StringArena *arena,
+                       SymbolTable *symbols) {
+  for (size_t j = 0; j < table->count; ++j) {
+    ExpansionPart *part = table->parts + j;
+    part->text.string = string_arena_get_str(arena, part->text.handle);
+    if (part->variable.name != STRING_HANDLE_NULL) {
+      link_variable(&part->variable, arena, symbols);
+    }
   }
-  return (Error){ERROR_NONE};
 }
 
-Error compile(ASTNode *input, OpBuffer *out) {
-  op_buffer_init(out);
+/// Link the argv of an operation, along with its tables.
+static char **link_argv(StringArena *arena, SymbolTable *symbols,
+                        StringHandle argv, size_t arg_count, OpFlag flag) {
+  // The name, the arguments, NULL, and then the table of redirects, the
+  // table of substitutions, and the table of bindings.
+  bool redirect = flag & OP_FLAG_REDIRECT;
+  bool expand = flag & OP_FLAG_EXPAND;
+  size_t count = arg_count + 2 + op_table_count(flag);
+  string_arena_link_argv(arena, argv, count);
+  char **linked = string_arena_get_argv(arena, argv);
+  if (redirect) {
+    RedirectTable *table = (RedirectTable *)linked[arg_count + 2];
+    for (size_t j = 0; j < table->count; ++j) {
+      Redirect *r = table->redirects + j;
+      if (redirect_has_string(r->type)) {
+        r->data.string = string_arena_get_str(arena, r->data.handle);
+      } else if (r->type == REDIRECT_TEMPLATE) {
+        ExpansionTable *parts = string_arena_get_data(arena, r->data.handle);
+        link_parts(parts, arena, symbols);
+        r->data.expansion = parts;
+      }
+    }
+  }
+  if (expand) {
+    link_parts((ExpansionTable *)op_expansions(linked, arg_count, flag), arena,
+               symbols);
+  }
+  if (flag & OP_FLAG_OVERLAY) {
+    OverlayTable *table = (OverlayTable *)op_overlay(linked, arg_count, flag);
+    // The bindings, and the NULL after them.
+    string_arena_link_argv(arena, argv + count * sizeof(StringHandle),
+                           table->count + 1);
+    char **bindings = op_bindings(linked, arg_count, flag);
+    for (size_t j = 0; j < table->count; ++j) {
+      StringSlice name = {.data = bindings[j],
+                          .len = strchr(bindings[j], '=') - bindings[j]};
+      table->symbols[j] = symbol_table_intern(symbols, name);
+    }
+  }
+  return linked;
+}
 
-  return handle_node(input, OP_FLAG_NONE, out);
+void op_buffer_link(OpBuffer *buf, StringArena *arena, SymbolTable *symbols) {
+  for (size_t i = 0; i < buf->len; ++i) {
+    Op op = buf->ops[i];
+    if (op.type == OP_ASSIGN) {
+      link_variable(string_arena_get_data(arena, op.data.assign.variable),
+                    arena, symbols);
+      link_argv(arena, symbols, op.data.assign.argv, 0, op.flag);
+      continue;
+    }
+    bool builtin = op_is_builtin(op.type);
+    if (!builtin && !op_is_command(op.type)) {
+      continue;
+    }
+    StringHandle argv = builtin ? op.data.builtin.argv : op.data.command.argv;
+    size_t arg_count =
+        builtin ? op.data.builtin.arg_count : op.data.command.arg_count;
+    char **linked = link_argv(arena, symbols, argv, arg_count, op.flag);
+    // Builtins get their name from their description, not the arena.
+    if (builtin) {
+      linked[0] = (char *)builtin_spec(op.data.builtin.builtin)->name;
+    }
+  }
 }
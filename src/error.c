@@ -5,6 +5,18 @@ char const *lexer_error_str(LexerError err) {
   case LEXER_ERROR_UNKNOWN_INPUT: {
     return "Lexer: unknown input";
   }
+  case LEXER_ERROR_UNTERMINATED_QUOTE: {
+    return "Lexer: unterminated quote";
+  }
+  case LEXER_ERROR_UNTERMINATED_HERE_DOC: {
+    return "Lexer: unterminated here-document";
+  }
+  case LEXER_ERROR_HERE_DOC_WORD: {
+    return "Lexer: expected a word after << or <<<";
+  }
+  case LEXER_ERROR_BAD_SUBSTITUTION: {
+    return "Lexer: bad substitution";
+  }
   }
   return "";
 }
@@ -14,6 +26,9 @@ char const *parser_error_str(ParserError err) {
   case PARSER_ERROR_UNEXPECTED_TOKEN: {
     return "Parser: unexpected token";
   }
+  case PARSER_ERROR_BACKGROUND_LIST: {
+    return "Parser: only pipelines can run in the background";
+  }
   }
   return "";
 }
@@ -40,7 +55,8 @@ char const *error_str(Error err) {
     return parser_error_str(err.data.parser_error);
   case ERROR_INTERPRETER:
     return interpreter_error_str(err.data.intepreter_error);
-  case ERROR_UNIX: {
+  case ERROR_UNIX:
+  case ERROR_REDIRECT: {
     return strerror(err.data.errnum);
   }
   }
@@ -1,32 +1,25 @@
+// For pipe2, F_SETPIPE_SZ, and memfd_create.
+#define _GNU_SOURCE
+
 #include "errno.h"
 #include "fcntl.h"
+#include "limits.h"
+#include "sys/mman.h"
 #include "sys/types.h"
 #include "sys/wait.h"
 #include "unistd.h"
 
 #include "include/builtin.h"
+#include "include/command_cache.h"
 #include "include/interpreter.h"
+#include "include/pipe_writer.h"
+#include "include/reaper.h"
+#include "include/spawn.h"
+#include "include/stats.h"
+#include "include/trace.h"
 
-int print_working_directory() {
-  char buf[1024];
-  if (getcwd(buf, 1024) == NULL) {
-    return errno;
-  }
-  if (puts(buf) < 0) {
-    return errno;
-  }
-  return 0;
-}
-
-int change_directory(char *dir) {
-  if (chdir(dir) < 0) {
-    return errno;
-  }
-  return 0;
-}
-
-int launch_command(char *name, char **argv) {
-  if (execvp(name, argv) == -1) {
+int launch_command(char const *path, char **argv, char **envp) {
+  if (execve(path, argv, envp) == -1) {
     return errno;
   }
   return 0;
@@ -34,18 +27,18 @@ int launch_command(char *name, char **argv) {
 
 typedef enum RunnableType {
   RUNNABLE_COMMAND,
-  RUNNABLE_CD,
-  RUNNABLE_PWD,
 } RunnableType;
 
 typedef struct RunnableDataCommand {
-  char *name;
+  char const *name;
+  char const *path;
   char **argv;
+  /// The environment, from `symbol_table_environ`.
+  char **envp;
 } RunnableDataCommand;
 
 typedef union RunnableData {
   RunnableDataCommand command;
-  char *cd;
 } RunnableData;
 
 typedef struct Runnable {
@@ -56,13 +49,8 @@ typedef struct Runnable {
 int runnable_run(Runnable r) {
   switch (r.type) {
   case RUNNABLE_COMMAND: {
-    return launch_command(r.data.command.name, r.data.command.argv);
-  }
-  case RUNNABLE_PWD: {
-    return print_working_directory();
-  }
-  case RUNNABLE_CD: {
-    return change_directory(r.data.cd);
+    return launch_command(r.data.command.path, r.data.command.argv,
+                          r.data.command.envp);
   }
   }
   return 0;
@@ -71,6 +59,12 @@ int runnable_run(Runnable r) {
 typedef struct ProcessHandle {
   pid_t pid;
   int err_fd;
+  /// The name the command was looked up with.
+  char const *name;
+  /// The index of this process in its pipeline.
+  size_t stage;
+  /// When the process was started, as given by `stats_now`.
+  uint64_t start_ns;
 } ProcessHandle;
 
 typedef struct ProcessHandleBuf {
@@ -113,18 +107,22 @@ void process_handle_buf_push(ProcessHandleBuf *buf, ProcessHandle handle) {
   buf->buf[buf->count++] = handle;
 }
 
-Error launch(Runnable r, ProcessHandle *handle_out, int redirect_stdout,
-             int redirect_stdin) {
+Error launch_untimed(Runnable r, SpawnBackend backend,
+                     ProcessHandle *handle_out, SpawnIO const *io) {
   if (fflush(stdout) == -1) {
     return error_from_errno(errno);
   }
 
-  int err_pipe[2];
-  if (pipe(err_pipe) == -1) {
-    return error_from_errno(errno);
+  handle_out->name = r.data.command.name;
+  if (backend == SPAWN_BACKEND_POSIX_SPAWN) {
+    handle_out->err_fd = -1;
+    return spawn_command(r.data.command.path, r.data.command.argv,
+                         r.data.command.envp, io, &handle_out->pid);
   }
-  if (fcntl(err_pipe[1], F_SETFD, fcntl(err_pipe[1], F_GETFD) | FD_CLOEXEC) ==
-      -1) {
+
+  // Exec closes the write end, which is how the parent knows it succeeded.
+  int err_pipe[2];
+  if (pipe2(err_pipe, O_CLOEXEC) == -1) {
     return error_from_errno(errno);
   }
   pid_t pid = fork();
@@ -134,14 +132,12 @@ Error launch(Runnable r, ProcessHandle *handle_out, int redirect_stdout,
   if (pid == 0) {
     close(err_pipe[0]);
 
-    if (redirect_stdout != -1) {
-      dup2(redirect_stdout, fileno(stdout));
-    }
-    if (redirect_stdin != -1) {
-      dup2(redirect_stdin, fileno(stdin));
+    // A redirect which failed is sent back negated, to tell it apart from a
+    // failure to exec.
+    int err_out = -spawn_io_apply(io);
+    if (err_out == 0) {
+      err_out = runnable_run(r);
     }
-
-    int err_out = runnable_run(r);
     if (err_out != 0) {
       write(err_pipe[1], &err_out, sizeof(int));
       close(err_pipe[1]);
@@ -156,271 +152,1695 @@ Error launch(Runnable r, ProcessHandle *handle_out, int redirect_stdout,
   return (Error){ERROR_NONE};
 }
 
-Error wait_on_handle(ProcessHandle *handle) {
+Error launch(Runnable r, SpawnBackend backend, ProcessHandle *handle_out,
+             SpawnIO const *io) {
+  uint64_t start = stats_now();
+  Error err = launch_untimed(r, backend, handle_out, io);
+  stats_record(STATS_LAUNCH, start);
+  handle_out->start_ns = start;
+  if (err.type == ERROR_NONE && trace_enabled()) {
+    TraceArgs args = {.pid = handle_out->pid,
+                      .argv0 = handle_out->name,
+                      .stage = handle_out->stage,
+                      .redirects = io->redirects};
+    trace_span("launch", start, 0, &args);
+  }
+  return err;
+}
+
+/// Convert a status from waitpid into an exit status, like sh does.
+int exit_status(int wstatus) {
+  if (WIFSIGNALED(wstatus)) {
+    return 128 + WTERMSIG(wstatus);
+  }
+  return WEXITSTATUS(wstatus);
+}
+
+/// The exit status of a command which couldn't be executed, like in sh.
+int exec_failure_status(int errnum) {
+  return errnum == ENOENT ? 127 : 126;
+}
+
+/// The exit status of a command which couldn't be started, whether because
+/// of one of its redirects, or because it couldn't be executed.
+int start_failure_status(Error err) {
+  return err.type == ERROR_REDIRECT ? 1 : exec_failure_status(err.data.errnum);
+}
+
+/// Check whether a reaped process failed to exec, closing its error pipe.
+///
+/// The process has exited, so reading from the pipe never blocks.
+Error check_exec_error(ProcessHandle *handle, CommandCache *cache) {
+  // Spawned processes have already reported any failure to exec.
+  if (handle->err_fd == -1) {
+    return (Error){ERROR_NONE};
+  }
+  uint64_t start = stats_now();
   int exec_err;
-  int count;
-  for (count = -1; count == -1;
-       count = read(handle->err_fd, &exec_err, sizeof(int))) {
-    if (errno == EAGAIN || errno == EINTR) {
-      continue;
+  ssize_t count;
+  do {
+    count = read(handle->err_fd, &exec_err, sizeof(int));
+  } while (count == -1 && errno == EINTR);
+  close(handle->err_fd);
+  stats_record(STATS_EXEC_CHECK, start);
+  if (count == sizeof(int)) {
+    if (exec_err < 0) {
+      return (Error){ERROR_REDIRECT, {.errnum = -exec_err}};
     }
+    if (exec_err == ENOENT) {
+      command_cache_forget(cache, handle->name);
+    }
+    return error_from_errno(exec_err);
   }
-  close(handle->err_fd);
-  if (wait(&handle->pid) == -1) {
+  return (Error){ERROR_NONE};
+}
+
+/// Write a string into an anonymous file in memory, for a here-document or a
+/// here-string.
+///
+/// The command then reads it like any other file, without a pipe, or anything
+/// feeding it.
+Error string_fd_untraced(char const *string, int *fd_out) {
+  int fd = memfd_create("sally-here-doc", MFD_CLOEXEC);
+  if (fd == -1) {
     return error_from_errno(errno);
   }
-  if (count > 0) {
-    return error_from_errno(exec_err);
+  // Writing at an offset leaves the file position at the start, for reading.
+  size_t len = strlen(string);
+  for (size_t done = 0; done < len;) {
+    ssize_t count = pwrite(fd, string + done, len - done, done);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      int errnum = errno;
+      close(fd);
+      return error_from_errno(errnum);
+    }
+    done += count;
   }
+  *fd_out = fd;
   return (Error){ERROR_NONE};
 }
 
-Error redirect_stdout(char *file_name, int *fd_out) {
-  FILE *fp = fopen(file_name, "w");
-  if (fp == NULL) {
-    return error_from_errno(errno);
+Error string_fd(char const *string, int *fd_out) {
+  uint64_t start = stats_now();
+  Error err = string_fd_untraced(string, fd_out);
+  if (trace_enabled()) {
+    trace_span("redirect", start, 0, NULL);
   }
+  return err;
+}
 
-  Error err;
+/// The exit status of each stage in a pipeline.
+typedef struct PipeStatus {
+  int *statuses;
+  size_t count;
+  size_t capacity;
+} PipeStatus;
 
-  fflush(stdout);
-  *fd_out = dup(fileno(stdout));
-  if (*fd_out == -1) {
-    err = error_from_errno(errno);
-    goto err0;
-  }
+const size_t PIPE_STATUS_START_CAPACITY = 4;
 
-  if (dup2(fileno(fp), fileno(stdout)) < 0) {
-    err = error_from_errno(errno);
-    goto err1;
+PipeStatus pipe_status_init() {
+  PipeStatus out = {.count = 0, .capacity = PIPE_STATUS_START_CAPACITY};
+  out.statuses = malloc(out.capacity * sizeof(int));
+  if (out.statuses == NULL) {
+    panic("interpreter: failed to allocate");
   }
+  return out;
+}
 
-  fclose(fp);
-  return (Error){ERROR_NONE};
-
-err1:
-  close(*fd_out);
-err0:
-  fclose(fp);
-  return err;
+/// Add a stage with a given status, returning its index.
+size_t pipe_status_push(PipeStatus *status, int value) {
+  if (status->count >= status->capacity) {
+    status->capacity *= 2;
+    status->statuses =
+        realloc(status->statuses, status->capacity * sizeof(int));
+    if (status->statuses == NULL) {
+      panic("interpreter: failed to allocate");
+    }
+  }
+  status->statuses[status->count] = value;
+  return status->count++;
 }
 
-void restore_stdout(int fd) {
-  fflush(stdout);
-  dup2(fd, fileno(stdout));
-  close(fd);
+/// Record the status of a process which was reaped, with the error from
+/// reaping it, if any.
+///
+/// This also checks whether the process managed to run its command.
+Error process_reaped(ProcessHandle *handle, PipeStatus *status,
+                     CommandCache *cache, Error err, int wstatus) {
+  if (err.type == ERROR_NONE) {
+    status->statuses[handle->stage] = exit_status(wstatus);
+  }
+  if (trace_enabled()) {
+    TraceArgs args = {
+        .pid = handle->pid, .argv0 = handle->name, .stage = handle->stage};
+    trace_span("child", handle->start_ns, handle->pid, &args);
+  }
+  Error exec_err = check_exec_error(handle, cache);
+  handle->err_fd = -1;
+  if (exec_err.type != ERROR_NONE) {
+    status->statuses[handle->stage] = start_failure_status(exec_err);
+    return exec_err;
+  }
+  return err;
 }
 
-const size_t STRING_STACK_START_CAPACITY = 32;
+/// A statement running in the background.
+typedef struct Job {
+  /// The number of this job, as used in `%1`.
+  size_t id;
+  /// The names of its commands, separated by pipes.
+  char *command;
+  /// The processes of this job, with their names copied.
+  ProcessHandle *handles;
+  size_t handle_count;
+  /// The tag of the first process in the reaper, the others following it.
+  size_t first_tag;
+  PipeStatus status;
+  /// The number of processes which haven't been reaped yet.
+  size_t remaining;
+  /// The output of its builtins still being written into its pipes, or NULL.
+  PipeWriters *writers;
+} Job;
 
-typedef struct StringStack {
-  StringHandle *buf;
-  size_t head;
+typedef struct JobTable {
+  Job *jobs;
+  size_t count;
   size_t capacity;
-} StringStack;
+  /// The tag to give the first process of the next job.
+  size_t next_tag;
+} JobTable;
 
-StringStack *string_stack_init() {
-  StringStack *out = malloc(sizeof(StringStack));
-  if (out == NULL) {
+const size_t JOB_TABLE_START_CAPACITY = 4;
+
+JobTable job_table_init() {
+  JobTable out = {.count = 0, .capacity = JOB_TABLE_START_CAPACITY};
+  out.next_tag = 0;
+  out.jobs = malloc(out.capacity * sizeof(Job));
+  if (out.jobs == NULL) {
     panic("interpreter: failed to allocate");
   }
-  out->head = 0;
-  out->capacity = STRING_STACK_START_CAPACITY;
-  out->buf = malloc(out->capacity * sizeof(StringHandle));
-  if (out->buf == NULL) {
+  return out;
+}
+
+void job_free(Job *job) {
+  for (size_t i = 0; i < job->handle_count; ++i) {
+    // A process which was never reaped still holds its error pipe.
+    if (job->handles[i].err_fd != -1) {
+      close(job->handles[i].err_fd);
+    }
+    free((char *)job->handles[i].name);
+  }
+  free(job->handles);
+  free(job->command);
+  free(job->status.statuses);
+  if (job->writers != NULL) {
+    pipe_writers_free(job->writers);
+  }
+}
+
+void job_table_free(JobTable *table) {
+  for (size_t i = 0; i < table->count; ++i) {
+    job_free(table->jobs + i);
+  }
+  free(table->jobs);
+}
+
+/// Create a job out of the processes of a statement.
+///
+/// Jobs get the number after that of the last job, so they stay sorted.
+Job *job_table_push(JobTable *table, ProcessHandleBuf *processes,
+                    PipeStatus *status) {
+  if (table->count >= table->capacity) {
+    table->capacity *= 2;
+    table->jobs = realloc(table->jobs, table->capacity * sizeof(Job));
+    if (table->jobs == NULL) {
+      panic("interpreter: failed to allocate");
+    }
+  }
+  Job *job = table->jobs + table->count;
+  job->id = table->count == 0 ? 1 : table->jobs[table->count - 1].id + 1;
+  table->count++;
+
+  size_t command_len = 1;
+  for (size_t i = 0; i < processes->count; ++i) {
+    command_len += strlen(processes->buf[i].name) + 3;
+  }
+  job->command = malloc(command_len);
+  job->handles = malloc(processes->count * sizeof(ProcessHandle));
+  if (job->command == NULL || job->handles == NULL) {
     panic("interpreter: failed to allocate");
   }
-  return out;
+  job->command[0] = '\0';
+  for (size_t i = 0; i < processes->count; ++i) {
+    if (i > 0) {
+      strcat(job->command, " | ");
+    }
+    strcat(job->command, processes->buf[i].name);
+    job->handles[i] = processes->buf[i];
+    job->handles[i].name = strdup(processes->buf[i].name);
+    if (job->handles[i].name == NULL) {
+      panic("interpreter: failed to allocate");
+    }
+  }
+  job->handle_count = processes->count;
+  job->remaining = processes->count;
+  job->writers = NULL;
+  job->first_tag = table->next_tag;
+  table->next_tag += processes->count;
+
+  job->status = pipe_status_init();
+  for (size_t i = 0; i < status->count; ++i) {
+    pipe_status_push(&job->status, status->statuses[i]);
+  }
+  return job;
+}
+
+/// Find the job a process was watched for, by its tag.
+Job *job_table_find_tag(JobTable *table, size_t tag) {
+  for (size_t i = 0; i < table->count; ++i) {
+    Job *job = table->jobs + i;
+    if (tag >= job->first_tag && tag < job->first_tag + job->handle_count) {
+      return job;
+    }
+  }
+  return NULL;
 }
 
-void string_stack_reset(StringStack *stack) {
-  stack->head = 0;
+/// Find a job from an argument to a builtin, like `%1`, or the pid of one of
+/// its processes.
+Job *job_table_find_arg(JobTable *table, char const *arg) {
+  bool by_id = arg[0] == '%';
+  char *end;
+  long long value = strtoll(arg + by_id, &end, 10);
+  if (*end != '\0' || end == arg + by_id) {
+    return NULL;
+  }
+  for (size_t i = 0; i < table->count; ++i) {
+    Job *job = table->jobs + i;
+    if (by_id && (long long)job->id == value) {
+      return job;
+    }
+    for (size_t j = 0; !by_id && j < job->handle_count; ++j) {
+      if (job->handles[j].pid == value) {
+        return job;
+      }
+    }
+  }
+  return NULL;
+}
+
+void job_table_remove(JobTable *table, Job *job) {
+  job_free(job);
+  size_t index = job - table->jobs;
+  memmove(job, job + 1, (table->count - index - 1) * sizeof(Job));
+  table->count--;
+}
+
+/// The exit status of a job, which is that of its last stage.
+int job_exit_status(Job *job) {
+  return job->status.count == 0 ? 0
+                                : job->status.statuses[job->status.count - 1];
+}
+
+void job_print(Job *job, FILE *out) {
+  if (job->remaining > 0) {
+    fprintf(out, "[%zu] Running\t%s\n", job->id, job->command);
+  } else if (job_exit_status(job) == 0) {
+    fprintf(out, "[%zu] Done\t%s\n", job->id, job->command);
+  } else {
+    fprintf(out, "[%zu] Exit %d\t%s\n", job->id, job_exit_status(job),
+            job->command);
+  }
 }
 
-void string_stack_free(StringStack *stack) {
-  free(stack->buf);
-  free(stack);
+/// A block of memory expanded words are allocated from.
+typedef struct ExpansionBlock {
+  char *data;
+  size_t len;
+  size_t capacity;
+} ExpansionBlock;
+
+/// Memory for the words expanded by a statement, which lasts until the
+/// statement ends.
+///
+/// The argv of each command points into it, so blocks never move once
+/// allocated, and are kept around for the statements after, like the blocks
+/// of an `ASTArena`.
+typedef struct ExpansionArena {
+  ExpansionBlock *blocks;
+  size_t count;
+  size_t capacity;
+  /// The block memory is currently allocated from.
+  size_t current;
+} ExpansionArena;
+
+const size_t EXPANSION_BLOCK_SIZE = 1 << 12;
+
+/// Add a new block, big enough to hold at least `min` bytes.
+static void expansion_arena_add_block(ExpansionArena *arena, size_t min) {
+  if (arena->count >= arena->capacity) {
+    arena->capacity = arena->capacity == 0 ? 4 : arena->capacity * 2;
+    arena->blocks =
+        realloc(arena->blocks, arena->capacity * sizeof(ExpansionBlock));
+    if (arena->blocks == NULL) {
+      panic("interpreter: failed to allocate");
+    }
+  }
+  size_t capacity = arena->count == 0
+                        ? EXPANSION_BLOCK_SIZE
+                        : arena->blocks[arena->count - 1].capacity * 2;
+  while (capacity < min) {
+    capacity *= 2;
+  }
+  char *data = malloc(capacity);
+  if (data == NULL) {
+    panic("interpreter: failed to allocate");
+  }
+  arena->blocks[arena->count++] =
+      (ExpansionBlock){.data = data, .len = 0, .capacity = capacity};
 }
 
-size_t string_stack_size(StringStack *stack) {
-  return stack->head;
+/// Allocate memory lasting until the arena is reset, aligned for pointers.
+static void *expansion_arena_alloc(ExpansionArena *arena, size_t size) {
+  size = (size + _Alignof(char *) - 1) & ~(_Alignof(char *) - 1);
+  if (arena->count == 0) {
+    expansion_arena_add_block(arena, size);
+  }
+  ExpansionBlock *block = arena->blocks + arena->current;
+  while (block->capacity - block->len < size) {
+    // Blocks from before the last reset get reused first.
+    if (arena->current + 1 >= arena->count) {
+      expansion_arena_add_block(arena, size);
+    }
+    block = arena->blocks + ++arena->current;
+    block->len = 0;
+  }
+  void *out = block->data + block->len;
+  block->len += size;
+  return out;
 }
 
-StringHandle string_stack_pop(StringStack *stack) {
-  return stack->buf[--stack->head];
+static void expansion_arena_reset(ExpansionArena *arena) {
+  arena->current = 0;
+  if (arena->count > 0) {
+    arena->blocks[0].len = 0;
+  }
 }
 
-void string_stack_push(StringStack *stack, StringHandle string) {
-  size_t required = stack->head + 1;
-  while (stack->capacity < required) {
-    stack->capacity *= 2;
-    stack->buf = realloc(stack->buf, stack->capacity * sizeof(StringHandle));
+static void expansion_arena_free(ExpansionArena *arena) {
+  for (size_t i = 0; i < arena->count; ++i) {
+    free(arena->blocks[i].data);
   }
-  stack->buf[stack->head++] = string;
+  free(arena->blocks);
 }
 
 struct Interpreter {
   StringArena *arena;
-  StringStack *string_stack;
+  SymbolTable *symbols;
+  /// The symbols for `$PATH`, which sets where commands are searched for, and
+  /// for `$?`, which is the exit status of the last statement.
+  Symbol path_symbol;
+  Symbol status_symbol;
+  /// The words expanded by the statement running now.
+  ExpansionArena expansions;
+  /// Where `$?` gets formatted.
+  char status_text[16];
   ProcessHandleBuf *process_buf;
+  SpawnBackend backend;
+  CommandCache *command_cache;
+  PipeWriters *pipe_writers;
+  Reaper *reaper;
+  /// Background jobs, whose processes are watched by their own reaper.
+  JobTable jobs;
+  Reaper *job_reaper;
+  /// The statuses of the statement running now, and of the one before it.
+  PipeStatus status;
+  PipeStatus last_status;
+  /// The exit status of the last statement, like `$?` in sh.
+  int exit_status;
 
-  char **argv_buf;
-  size_t argv_buf_capacity;
   int last_pipe_fd;
+  /// The capacity of pipes between stages, or 0 for the kernel's default.
+  int pipe_size;
+  /// The descriptors holding the strings of the command being launched.
+  int *string_fds;
+  size_t string_fds_capacity;
 };
 
-Interpreter *interpreter_init(StringArena *arena) {
+const size_t STRING_FDS_START_CAPACITY = 4;
+
+/// The capacity asked for with `SALLY_PIPE_SIZE`, or 0 if there's none.
+///
+/// The size is in bytes, or in KiB or MiB with a `k` or `m` suffix.
+static int pipe_size_from_env() {
+  char const *value = getenv("SALLY_PIPE_SIZE");
+  if (value == NULL) {
+    return 0;
+  }
+  char *end;
+  long size = strtol(value, &end, 10);
+  if (*end == 'k' || *end == 'K') {
+    size <<= 10;
+    ++end;
+  } else if (*end == 'm' || *end == 'M') {
+    size <<= 20;
+    ++end;
+  }
+  if (*end != '\0' || size <= 0 || size > INT_MAX) {
+    return 0;
+  }
+  return size;
+}
+
+Interpreter *interpreter_init(StringArena *arena, SymbolTable *symbols) {
   Interpreter *out = malloc(sizeof(Interpreter));
   if (out == NULL) {
     panic("interpreter_init: failed to allocate memory");
   }
   out->arena = arena;
-  out->string_stack = string_stack_init();
+  out->symbols = symbols;
+  out->path_symbol =
+      symbol_table_intern(symbols, (StringSlice){.data = "PATH", .len = 4});
+  out->status_symbol =
+      symbol_table_intern(symbols, (StringSlice){.data = "?", .len = 1});
+  out->expansions =
+      (ExpansionArena){.blocks = NULL, .count = 0, .capacity = 0, .current = 0};
   out->process_buf = process_handle_buf_init();
-  out->argv_buf = NULL;
-  out->argv_buf_capacity = 0;
+  out->backend = spawn_backend_from_env();
+  out->command_cache = command_cache_init();
+  command_cache_set_path(out->command_cache,
+                         symbol_table_get(symbols, out->path_symbol).data);
+  out->pipe_writers = pipe_writers_init();
+  out->reaper = reaper_init();
+  out->jobs = job_table_init();
+  out->job_reaper = reaper_init();
+  out->status = pipe_status_init();
+  out->last_status = pipe_status_init();
+  out->exit_status = 0;
   out->last_pipe_fd = -1;
+  out->pipe_size = pipe_size_from_env();
+  out->string_fds_capacity = STRING_FDS_START_CAPACITY;
+  out->string_fds = malloc(out->string_fds_capacity * sizeof(int));
+  if (out->string_fds == NULL) {
+    panic("interpreter_init: failed to allocate memory");
+  }
   return out;
 }
 
 void interpreter_free(Interpreter *interpreter) {
-  string_stack_free(interpreter->string_stack);
   process_handle_buf_free(interpreter->process_buf);
-  free(interpreter->argv_buf);
+  command_cache_free(interpreter->command_cache);
+  pipe_writers_free(interpreter->pipe_writers);
+  reaper_free(interpreter->reaper);
+  job_table_free(&interpreter->jobs);
+  reaper_free(interpreter->job_reaper);
+  free(interpreter->status.statuses);
+  free(interpreter->last_status.statuses);
+  free(interpreter->string_fds);
+  expansion_arena_free(&interpreter->expansions);
   free(interpreter);
 }
 
-Error interpreter_runnable(Interpreter *interpreter, Runnable r, OpFlag flag) {
-  int fd;
-  if (flag & OP_FLAG_REDIRECT) {
-    StringHandle file_h = string_stack_pop(interpreter->string_stack);
-    char *file = string_arena_get_str(interpreter->arena, file_h);
+/// The value of a variable, which is empty if it isn't set.
+static StringSlice interpreter_value(Interpreter *interpreter, Symbol symbol) {
+  if (symbol == SYMBOL_NONE) {
+    return (StringSlice){.data = "", .len = 0};
+  }
+  if (symbol == interpreter->status_symbol) {
+    int len = snprintf(interpreter->status_text,
+                       sizeof(interpreter->status_text), "%d",
+                       interpreter->exit_status);
+    return (StringSlice){.data = interpreter->status_text, .len = len};
+  }
+  StringSlice value = symbol_table_get(interpreter->symbols, symbol);
+  if (value.data == NULL) {
+    return (StringSlice){.data = "", .len = 0};
+  }
+  return value;
+}
+
+/// Put together the parts of a single template, which lasts until the
+/// statement ends.
+static char *interpreter_expand_parts(Interpreter *interpreter,
+                                      ExpansionPart const *parts,
+                                      size_t count) {
+  size_t len = 0;
+  for (size_t i = 0; i < count; ++i) {
+    len += parts[i].text_len +
+           interpreter_value(interpreter, parts[i].variable.symbol).len;
+  }
+  char *out = expansion_arena_alloc(&interpreter->expansions, len + 1);
+  char *at = out;
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(at, parts[i].text.string, parts[i].text_len);
+    at += parts[i].text_len;
+    StringSlice value =
+        interpreter_value(interpreter, parts[i].variable.symbol);
+    memcpy(at, value.data, value.len);
+    at += value.len;
+  }
+  *at = '\0';
+  return out;
+}
+
+/// Expand the words of an operation whose flags include `OP_FLAG_EXPAND`.
+///
+/// This returns a copy of its argv, with each word containing substitutions
+/// replaced with the result, which lasts until the statement ends. Each word
+/// stays a single argument, whatever the values of its variables.
+static char **interpreter_expand(Interpreter *interpreter, char **argv,
+                                 size_t arg_count, OpFlag flag) {
+  ExpansionTable const *table = op_expansions(argv, arg_count, flag);
+  // The name, the arguments, NULL, the tables, and the bindings, if any,
+  // which can have substitutions too.
+  size_t count = arg_count + 2 + op_table_count(flag);
+  if (flag & OP_FLAG_OVERLAY) {
+    count += op_overlay(argv, arg_count, flag)->count + 1;
+  }
+  char **out =
+      expansion_arena_alloc(&interpreter->expansions, count * sizeof(char *));
+  memcpy(out, argv, count * sizeof(char *));
+  for (size_t i = 0; i < table->count;) {
+    size_t arg = table->parts[i].arg;
+    size_t end = i;
+    for (; end < table->count && table->parts[end].arg == arg; ++end) {
+    }
+    out[arg] = interpreter_expand_parts(interpreter, table->parts + i, end - i);
+    i = end;
+  }
+  return out;
+}
+
+/// The text a here-document or here-string feeds to its descriptor, which is
+/// expanded first if it has substitutions.
+static char const *interpreter_redirect_text(Interpreter *interpreter,
+                                             Redirect const *r) {
+  if (r->type == REDIRECT_TEMPLATE) {
+    return interpreter_expand_parts(interpreter, r->data.expansion->parts,
+                                    r->data.expansion->count);
+  }
+  return r->data.string;
+}
+
+/// React to a variable being set, exported, or unset.
+///
+/// The symbol table already keeps the environment of commands up to date, so
+/// only `$PATH`, which sets where commands are searched for, needs anything.
+static void interpreter_variable_changed(Interpreter *interpreter,
+                                         Symbol symbol) {
+  if (symbol == interpreter->path_symbol) {
+    StringSlice value = symbol_table_get(interpreter->symbols, symbol);
+    command_cache_set_path(interpreter->command_cache, value.data);
+  }
+}
+
+char const *interpreter_variable(Interpreter *interpreter, char const *name) {
+  Symbol symbol = symbol_table_intern(
+      interpreter->symbols, (StringSlice){.data = name, .len = strlen(name)});
+  return symbol_table_get(interpreter->symbols, symbol).data;
+}
+
+/// Put the bindings of a command in the environment, if it has any.
+///
+/// They stay there until `interpreter_restore` is called, once the command
+/// has started, or the builtin has run.
+static void interpreter_overlay(Interpreter *interpreter, char **argv,
+                                size_t arg_count, OpFlag flag) {
+  if (flag & OP_FLAG_OVERLAY) {
+    OverlayTable const *table = op_overlay(argv, arg_count, flag);
+    symbol_table_overlay(interpreter->symbols, table->symbols,
+                         op_bindings(argv, arg_count, flag), table->count);
+  }
+}
 
-    Error err = redirect_stdout(file, &fd);
+/// Take the bindings of `interpreter_overlay` back out of the environment.
+static void interpreter_restore(Interpreter *interpreter, char **argv,
+                                size_t arg_count, OpFlag flag) {
+  if (flag & OP_FLAG_OVERLAY) {
+    OverlayTable const *table = op_overlay(argv, arg_count, flag);
+    symbol_table_restore(interpreter->symbols, table->symbols, table->count);
+  }
+}
+
+/// Open a pipe between two stages of a pipeline.
+///
+/// Both ends are closed on exec, so a child only ever gets the ends moved into
+/// place for it. Otherwise, a later stage could hold on to the write end of
+/// its own input, and never see it end.
+static Error interpreter_pipe(Interpreter *interpreter, int pipe_fd[2]) {
+  if (pipe2(pipe_fd, O_CLOEXEC) < 0) {
+    return error_from_errno(errno);
+  }
+  // Larger pipes mean fewer context switches between stages streaming lots of
+  // data. The kernel refuses sizes over /proc/sys/fs/pipe-max-size to users
+  // without privileges, in which case the default is kept.
+  if (interpreter->pipe_size > 0) {
+    fcntl(pipe_fd[1], F_SETPIPE_SZ, interpreter->pipe_size);
+  }
+  return (Error){ERROR_NONE};
+}
+
+/// Close the descriptors from `interpreter_open_strings`.
+static void interpreter_close_strings(Interpreter *interpreter, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    close(interpreter->string_fds[i]);
+  }
+}
+
+/// Write out the string of each here-document or here-string in a table, in
+/// order, setting count_out to how many there were.
+static Error interpreter_open_strings(Interpreter *interpreter,
+                                      RedirectTable const *redirects,
+                                      size_t *count_out) {
+  *count_out = 0;
+  if (redirects == NULL) {
+    return (Error){ERROR_NONE};
+  }
+  while (interpreter->string_fds_capacity < redirects->count) {
+    interpreter->string_fds_capacity *= 2;
+    interpreter->string_fds =
+        realloc(interpreter->string_fds,
+                interpreter->string_fds_capacity * sizeof(int));
+    if (interpreter->string_fds == NULL) {
+      panic("interpreter: failed to allocate");
+    }
+  }
+  for (size_t i = 0; i < redirects->count; ++i) {
+    Redirect const *r = redirects->redirects + i;
+    if (!redirect_reads_string(r->type)) {
+      continue;
+    }
+    Error err = string_fd(interpreter_redirect_text(interpreter, r),
+                          interpreter->string_fds + *count_out);
     if (err.type != ERROR_NONE) {
+      interpreter_close_strings(interpreter, *count_out);
       return err;
     }
+    ++*count_out;
   }
+  return (Error){ERROR_NONE};
+}
 
-  int redirect_stdin = -1;
+/// Launch a command, with the pipes its flags call for, and its redirects.
+///
+/// Redirects are only ever applied in the child, so the shell's own
+/// descriptors stay untouched.
+Error interpreter_runnable(Interpreter *interpreter, Runnable r, OpFlag flag,
+                           RedirectTable const *redirects) {
+  size_t string_count;
+  Error err = interpreter_open_strings(interpreter, redirects, &string_count);
+  if (err.type != ERROR_NONE) {
+    return err;
+  }
+
+  SpawnIO io = {.stdin_fd = -1,
+                .stdout_fd = -1,
+                .redirects = redirects,
+                .string_fds = interpreter->string_fds};
   if (flag & OP_FLAG_CONTINUE_PIPE) {
-    redirect_stdin = interpreter->last_pipe_fd;
+    io.stdin_fd = interpreter->last_pipe_fd;
+    interpreter->last_pipe_fd = -1;
   }
-  int redirect_stdout = -1;
+  // A redirect takes precedence over the pipe, which is then left unread, or
+  // empty, since the child applies redirects after pipes.
   int pipe_fd[2] = {-1, -1};
   if (flag & OP_FLAG_START_PIPE) {
-    if (pipe(pipe_fd) < 0) {
-      return error_from_errno(errno);
+    err = interpreter_pipe(interpreter, pipe_fd);
+    if (err.type != ERROR_NONE) {
+      interpreter_close_strings(interpreter, string_count);
+      return err;
     }
-    redirect_stdout = pipe_fd[1];
+    io.stdout_fd = pipe_fd[1];
     interpreter->last_pipe_fd = pipe_fd[0];
   }
 
   ProcessHandle handle;
-  Error err = launch(r, &handle, redirect_stdout, redirect_stdin);
-  if (redirect_stdin != -1) {
-    close(redirect_stdin);
+  handle.stage = interpreter->status.count;
+  err = launch(r, interpreter->backend, &handle, &io);
+  // The location we had cached might have gone stale, so search again.
+  if (err.type == ERROR_UNIX && err.data.errnum == ENOENT &&
+      r.data.command.path != r.data.command.name) {
+    command_cache_forget(interpreter->command_cache, r.data.command.name);
+    r.data.command.path =
+        command_cache_lookup(interpreter->command_cache, r.data.command.name);
+    if (r.data.command.path != NULL) {
+      err = launch(r, interpreter->backend, &handle, &io);
+    }
+  }
+  if (io.stdin_fd != -1) {
+    close(io.stdin_fd);
   }
   // Close the write end of the pipe
   if (pipe_fd[1] != -1) {
     close(pipe_fd[1]);
   }
-  if (flag & OP_FLAG_REDIRECT) {
-    restore_stdout(fd);
-  }
+  interpreter_close_strings(interpreter, string_count);
   if (err.type != ERROR_NONE) {
+    if (err.type == ERROR_UNIX || err.type == ERROR_REDIRECT) {
+      pipe_status_push(&interpreter->status, start_failure_status(err));
+    }
     return err;
   }
+  handle.stage = pipe_status_push(&interpreter->status, 0);
   process_handle_buf_push(interpreter->process_buf, handle);
   return (Error){ERROR_NONE};
 }
 
-Error interpreter_builtin(Interpreter *interpreter __attribute__((unused)),
-                          OpFlag flag, Builtin builtin) {
-  Runnable r;
-  switch (builtin) {
-  case BUILTIN_PWD: {
-    r = (Runnable){.type = RUNNABLE_PWD};
-    break;
+int interpreter_builtin_hash(BuiltinEnv *env, char **argv) {
+  CommandCache *cache = env->interpreter->command_cache;
+  if (argv[1] == NULL) {
+    command_cache_print(cache, env->out);
+    return 0;
   }
-  // We don't use a runnable for CD, since we have no output.
-  case BUILTIN_CD: {
-    if (string_stack_size(interpreter->string_stack) < 1) {
-      return (Error){ERROR_INTERPRETER,
-                     {.intepreter_error = INTERPRETER_ERROR_EMPTY_STACK}};
+  int status = 0;
+  for (char **arg = argv + 1; *arg != NULL; ++arg) {
+    if (strcmp(*arg, "-r") == 0) {
+      command_cache_clear(cache);
+    } else if (command_cache_lookup(cache, *arg) == NULL) {
+      fprintf(env->err, "hash: %s: not found\n", *arg);
+      status = 1;
     }
-    StringHandle dir_h = string_stack_pop(interpreter->string_stack);
-    char *dir = string_arena_get_str(interpreter->arena, dir_h);
+  }
+  return status;
+}
 
-    int err = change_directory(dir);
-    if (err != 0) {
-      return error_from_errno(err);
-    }
-    return (Error){ERROR_NONE};
+int interpreter_builtin_pipestatus(BuiltinEnv *env, char **argv) {
+  (void)argv;
+  PipeStatus *status = &env->interpreter->last_status;
+  for (size_t i = 0; i < status->count; ++i) {
+    fprintf(env->out, i == 0 ? "%d" : " %d", status->statuses[i]);
   }
+  fputc('\n', env->out);
+  return 0;
+}
+
+/// Whether a builtin's stream was opened for one of its redirects, rather than
+/// being one of the streams it started with.
+static bool builtin_owns(BuiltinEnv const *base, FILE *stream) {
+  return stream != base->out && stream != base->err;
+}
+
+/// Point the output or the errors of a builtin somewhere else, closing where
+/// they went before, unless something still uses it.
+static void builtin_replace(BuiltinEnv const *base, FILE **target,
+                            FILE *other, FILE *stream) {
+  FILE *old = *target;
+  *target = stream;
+  if (old != other && old != stream && builtin_owns(base, old)) {
+    fclose(old);
   }
-  return interpreter_runnable(interpreter, r, flag);
 }
 
-Error interpreter_command(Interpreter *interpreter __attribute__((unused)),
-                          OpFlag flag, char *name, size_t arg_count) {
-  if (arg_count + 2 > interpreter->argv_buf_capacity) {
-    interpreter->argv_buf_capacity *= 2;
-    interpreter->argv_buf =
-        realloc(interpreter->argv_buf, (arg_count + 2) * sizeof(char *));
+/// Open the file of a redirect, for a builtin.
+static Error builtin_open(Redirect const *r, int *fd_out) {
+  *fd_out = open(r->data.string, redirect_open_flags(r->type) | O_CLOEXEC,
+                 0666);
+  if (*fd_out == -1) {
+    return (Error){ERROR_REDIRECT, {.errnum = errno}};
   }
-  interpreter->argv_buf[0] = name;
-  for (size_t i = 1; i < arg_count + 1; ++i) {
-    StringHandle handle = string_stack_pop(interpreter->string_stack);
-    interpreter->argv_buf[i] = string_arena_get_str(interpreter->arena, handle);
+  return (Error){ERROR_NONE};
+}
+
+/// Apply the redirects of a builtin to its environment.
+///
+/// Builtins run in the shell itself, so instead of moving descriptors around,
+/// their input, output, and errors are swapped out, and only those are
+/// redirected. Whatever this opens is closed by `builtin_env_close`.
+static Error builtin_redirect(BuiltinEnv const *base, BuiltinEnv *env,
+                              RedirectTable const *redirects) {
+  for (size_t i = 0; i < redirects->count; ++i) {
+    Redirect const *r = redirects->redirects + i;
+    int fd = -1;
+    Error err = (Error){ERROR_NONE};
+    if (redirect_reads_string(r->type)) {
+      err = string_fd(interpreter_redirect_text(base->interpreter, r), &fd);
+    } else if (redirect_opens_file(r->type)) {
+      err = builtin_open(r, &fd);
+    }
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+
+    if (r->fd == STDIN_FILENO && fd != -1) {
+      if (env->in != base->in) {
+        close(env->in);
+      }
+      env->in = fd;
+      continue;
+    }
+    FILE **target = r->fd == STDOUT_FILENO   ? &env->out
+                    : r->fd == STDERR_FILENO ? &env->err
+                                             : NULL;
+    FILE **other = target == &env->out ? &env->err : &env->out;
+    // Builtins only ever use their input, output, and errors, but other files
+    // are still created, like in sh.
+    if (target == NULL ||
+        (fd != -1 && !(redirect_open_flags(r->type) & O_WRONLY))) {
+      if (fd != -1) {
+        close(fd);
+      }
+      continue;
+    }
+    if (r->type == REDIRECT_DUP) {
+      if (r->data.source_fd == r->fd) {
+        continue;
+      }
+      if (r->data.source_fd == STDOUT_FILENO ||
+          r->data.source_fd == STDERR_FILENO) {
+        builtin_replace(base, target, *other, *other);
+      }
+      continue;
+    }
+    FILE *stream = fdopen(fd, "w");
+    if (stream == NULL) {
+      close(fd);
+      return error_from_errno(errno);
+    }
+    builtin_replace(base, target, *other, stream);
+  }
+  return (Error){ERROR_NONE};
+}
+
+/// Close what `builtin_redirect` opened.
+static void builtin_env_close(BuiltinEnv const *base, BuiltinEnv *env) {
+  if (builtin_owns(base, env->out)) {
+    fclose(env->out);
+  }
+  if (env->err != env->out && builtin_owns(base, env->err)) {
+    fclose(env->err);
+  }
+  if (env->in != base->in) {
+    close(env->in);
+  }
+}
+
+/// Run a builtin, reading its input from a given descriptor.
+Error interpreter_builtin_from(Interpreter *interpreter, OpFlag flag,
+                               OpDataBuiltin builtin, int in) {
+  BuiltinSpec const *spec = builtin_spec(builtin.builtin);
+  char **argv = string_arena_get_argv(interpreter->arena, builtin.argv);
+  if (flag & OP_FLAG_EXPAND) {
+    argv = interpreter_expand(interpreter, argv, builtin.arg_count, flag);
   }
-  interpreter->argv_buf[arg_count + 1] = NULL;
 
-  Runnable r = {.type = RUNNABLE_COMMAND,
-                .data = {.command = {name, interpreter->argv_buf}}};
+  // Builtins run in the shell, even inside of a pipeline, writing straight
+  // into the pipe for the next stage.
+  BuiltinEnv base = {interpreter, stdout, stderr, in};
+  if (flag & OP_FLAG_START_PIPE) {
+    int pipe_fd[2];
+    Error err = interpreter_pipe(interpreter, pipe_fd);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    interpreter->last_pipe_fd = pipe_fd[0];
+    base.out = pipe_writers_open(interpreter->pipe_writers, pipe_fd[1]);
+    if (base.out == NULL) {
+      return error_from_errno(errno);
+    }
+  }
 
-  return interpreter_runnable(interpreter, r, flag);
+  // A redirect takes precedence over the pipe, which then stays empty.
+  BuiltinEnv env = base;
+  Error err = (Error){ERROR_NONE};
+  if (flag & OP_FLAG_REDIRECT) {
+    err = builtin_redirect(&base, &env, op_redirects(argv, builtin.arg_count));
+  }
+  // Builtins see variables as they are, but the commands they start, like
+  // those of parallel, get the bindings before them.
+  int status = 1;
+  if (err.type == ERROR_NONE) {
+    interpreter_overlay(interpreter, argv, builtin.arg_count, flag);
+    status = spec->run(&env, argv);
+    interpreter_restore(interpreter, argv, builtin.arg_count, flag);
+  }
+  pipe_status_push(&interpreter->status, status);
+  builtin_env_close(&base, &env);
+  // The helper thread, if any, finishes writing, and closes the pipe.
+  if (base.out != stdout) {
+    fclose(base.out);
+  }
+  return err;
 }
 
-Error interpreter_op(Interpreter *interpreter, Op op) {
-  switch (op.type) {
-  case OP_BUILTIN: {
-    return interpreter_builtin(interpreter, op.flag, op.data.builtin);
+Error interpreter_builtin(Interpreter *interpreter, OpFlag flag,
+                          OpDataBuiltin builtin) {
+  // Inside of a pipeline, builtins read straight from the previous stage. The
+  // pipe is closed once they're done, so that stage can stop early.
+  int in = STDIN_FILENO;
+  if (flag & OP_FLAG_CONTINUE_PIPE) {
+    in = interpreter->last_pipe_fd;
+    interpreter->last_pipe_fd = -1;
   }
-  case OP_STRING: {
-    string_stack_push(interpreter->string_stack, op.data.string);
-    break;
+  Error err = interpreter_builtin_from(interpreter, flag, builtin, in);
+  if (in != STDIN_FILENO && in != -1) {
+    close(in);
   }
-  case OP_COMMAND: {
-    char *name = string_arena_get_str(interpreter->arena, op.data.command.name);
-    return interpreter_command(interpreter, op.flag, name,
-                               op.data.command.arg_count);
+  return err;
+}
+
+/// Record a command which isn't anywhere on the path, like a child which
+/// failed to exec, without stopping the rest of its pipeline.
+///
+/// The stage before it, if any, is left with nobody reading its output, and
+/// the stage after it reads nothing.
+static Error interpreter_not_found(Interpreter *interpreter, OpFlag flag,
+                                   char const *name) {
+  fprintf(stderr, "%s: not found\n", name);
+  pipe_status_push(&interpreter->status, exec_failure_status(ENOENT));
+  if ((flag & OP_FLAG_CONTINUE_PIPE) && interpreter->last_pipe_fd != -1) {
+    close(interpreter->last_pipe_fd);
+    interpreter->last_pipe_fd = -1;
   }
+  if (flag & OP_FLAG_START_PIPE) {
+    int pipe_fd[2];
+    Error err = interpreter_pipe(interpreter, pipe_fd);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    close(pipe_fd[1]);
+    interpreter->last_pipe_fd = pipe_fd[0];
   }
   return (Error){ERROR_NONE};
 }
 
-Error interpreter_wait(Interpreter *interpreter) {
-  for (size_t i = 0; i < interpreter->process_buf->count; i++) {
-    Error err = wait_on_handle(interpreter->process_buf->buf + i);
+Error interpreter_command(Interpreter *interpreter, OpFlag flag,
+                          OpDataCommand command) {
+  // The compiler already laid out the arguments, ready to pass to exec.
+  char **argv = string_arena_get_argv(interpreter->arena, command.argv);
+  if (flag & OP_FLAG_EXPAND) {
+    argv = interpreter_expand(interpreter, argv, command.arg_count, flag);
+  }
+  char *name = argv[0];
+  char const *path = command_cache_lookup(interpreter->command_cache, name);
+  if (path == NULL) {
+    return interpreter_not_found(interpreter, flag, name);
+  }
+
+  // Bindings before the command are swapped into the environment only until
+  // it has started, rather than copying the rest of it.
+  interpreter_overlay(interpreter, argv, command.arg_count, flag);
+  Runnable r = {
+      .type = RUNNABLE_COMMAND,
+      .data = {.command = {name, path, argv,
+                           symbol_table_environ(interpreter->symbols)}}};
+
+  RedirectTable const *redirects = (flag & OP_FLAG_REDIRECT)
+                                       ? op_redirects(argv, command.arg_count)
+                                       : NULL;
+  Error err = interpreter_runnable(interpreter, r, flag, redirects);
+  interpreter_restore(interpreter, argv, command.arg_count, flag);
+  return err;
+}
+
+/// Assign to a variable, the value being a word like any other.
+Error interpreter_assign(Interpreter *interpreter, OpFlag flag,
+                         OpDataAssign assign) {
+  Variable const *variable =
+      string_arena_get_data(interpreter->arena, assign.variable);
+  char **argv = string_arena_get_argv(interpreter->arena, assign.argv);
+  if (flag & OP_FLAG_EXPAND) {
+    argv = interpreter_expand(interpreter, argv, 0, flag);
+  }
+  symbol_table_set(interpreter->symbols, variable->symbol,
+                   (StringSlice){.data = argv[0], .len = strlen(argv[0])});
+  interpreter_variable_changed(interpreter, variable->symbol);
+
+  // Like a builtin, an assignment affects the shell even inside of a
+  // pipeline, where it reads nothing, and writes nothing.
+  if (flag & OP_FLAG_CONTINUE_PIPE) {
+    close(interpreter->last_pipe_fd);
+    interpreter->last_pipe_fd = -1;
+  }
+  if (flag & OP_FLAG_START_PIPE) {
+    int pipe_fd[2];
+    Error err = interpreter_pipe(interpreter, pipe_fd);
     if (err.type != ERROR_NONE) {
       return err;
     }
+    close(pipe_fd[1]);
+    interpreter->last_pipe_fd = pipe_fd[0];
   }
+  pipe_status_push(&interpreter->status, 0);
   return (Error){ERROR_NONE};
 }
 
+/// Whether a string is a valid name for a variable.
+static bool valid_name(char const *name, size_t len) {
+  bool valid = len > 0 && !(*name >= '0' && *name <= '9');
+  for (size_t i = 0; i < len; ++i) {
+    char c = name[i];
+    valid = valid && (c == '_' || (c >= 'a' && c <= 'z') ||
+                      (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'));
+  }
+  return valid;
+}
+
+int interpreter_builtin_export(BuiltinEnv *env, char **argv) {
+  Interpreter *interpreter = env->interpreter;
+  SymbolTable *symbols = interpreter->symbols;
+  if (argv[1] == NULL) {
+    for (Symbol symbol = 0; symbol < symbol_table_count(symbols); ++symbol) {
+      StringSlice value = symbol_table_get(symbols, symbol);
+      if (value.data == NULL || !symbol_table_exported(symbols, symbol)) {
+        continue;
+      }
+      fprintf(env->out, "export %s='", symbol_table_name(symbols, symbol));
+      // Single quotes are written as '\'', so that the output can be read
+      // back in.
+      for (char const *at = value.data; *at != '\0'; ++at) {
+        if (*at == '\'') {
+          fputs("'\\''", env->out);
+        } else {
+          fputc(*at, env->out);
+        }
+      }
+      fputs("'\n", env->out);
+    }
+    return 0;
+  }
+  int status = 0;
+  for (char **arg = argv + 1; *arg != NULL; ++arg) {
+    char const *equals = strchr(*arg, '=');
+    size_t name_len = equals == NULL ? strlen(*arg) : (size_t)(equals - *arg);
+    if (!valid_name(*arg, name_len)) {
+      fprintf(env->err, "export: %s: not a valid name\n", *arg);
+      status = 1;
+      continue;
+    }
+    Symbol symbol = symbol_table_intern(
+        symbols, (StringSlice){.data = *arg, .len = name_len});
+    symbol_table_export(symbols, symbol);
+    if (equals != NULL) {
+      symbol_table_set(symbols, symbol,
+                       (StringSlice){.data = equals + 1,
+                                     .len = strlen(equals + 1)});
+    }
+    interpreter_variable_changed(interpreter, symbol);
+  }
+  return status;
+}
+
+int interpreter_builtin_unset(BuiltinEnv *env, char **argv) {
+  Interpreter *interpreter = env->interpreter;
+  int status = 0;
+  for (char **arg = argv + 1; *arg != NULL; ++arg) {
+    size_t len = strlen(*arg);
+    if (!valid_name(*arg, len)) {
+      fprintf(env->err, "unset: %s: not a valid name\n", *arg);
+      status = 1;
+      continue;
+    }
+    Symbol symbol = symbol_table_intern(
+        interpreter->symbols, (StringSlice){.data = *arg, .len = len});
+    symbol_table_unset(interpreter->symbols, symbol);
+    interpreter_variable_changed(interpreter, symbol);
+  }
+  return status;
+}
+
+/// Record that a process of a background job was reaped.
+///
+/// Nothing waits on background jobs, so errors are reported right away.
+void interpreter_job_reaped(Interpreter *interpreter, size_t tag, Error err,
+                            int wstatus) {
+  Job *job = job_table_find_tag(&interpreter->jobs, tag);
+  ProcessHandle *handle = job->handles + (tag - job->first_tag);
+  err = process_reaped(handle, &job->status, interpreter->command_cache, err,
+                       wstatus);
+  if (err.type != ERROR_NONE) {
+    fprintf(stderr, "[%zu] %s\n", job->id, error_str(err));
+  }
+  job->remaining--;
+  // With every reader gone, the writes feeding the job are done too.
+  if (job->remaining == 0 && job->writers != NULL) {
+    pipe_writers_free(job->writers);
+    job->writers = NULL;
+  }
+}
+
+void interpreter_poll_jobs(Interpreter *interpreter, FILE *report) {
+  for (;;) {
+    size_t tag;
+    int wstatus;
+    bool reaped;
+    Error err = reaper_poll(interpreter->job_reaper, &tag, &wstatus, &reaped);
+    if (!reaped) {
+      break;
+    }
+    interpreter_job_reaped(interpreter, tag, err, wstatus);
+  }
+  if (report == NULL) {
+    return;
+  }
+  JobTable *table = &interpreter->jobs;
+  for (size_t i = 0; i < table->count;) {
+    if (table->jobs[i].remaining > 0) {
+      ++i;
+      continue;
+    }
+    job_print(table->jobs + i, report);
+    job_table_remove(table, table->jobs + i);
+  }
+}
+
+/// Wait for the next process of any background job to exit.
+void interpreter_wait_job(Interpreter *interpreter) {
+  size_t tag;
+  int wstatus;
+  Error err = reaper_wait(interpreter->job_reaper, &tag, &wstatus);
+  interpreter_job_reaped(interpreter, tag, err, wstatus);
+}
+
+int interpreter_builtin_jobs(BuiltinEnv *env, char **argv) {
+  (void)argv;
+  interpreter_poll_jobs(env->interpreter, NULL);
+  // Like in sh, finished jobs are only listed once.
+  JobTable *table = &env->interpreter->jobs;
+  for (size_t i = 0; i < table->count;) {
+    job_print(table->jobs + i, env->out);
+    if (table->jobs[i].remaining > 0) {
+      ++i;
+    } else {
+      job_table_remove(table, table->jobs + i);
+    }
+  }
+  return 0;
+}
+
+int interpreter_builtin_wait(BuiltinEnv *env, char **argv) {
+  Interpreter *interpreter = env->interpreter;
+  JobTable *table = &interpreter->jobs;
+  if (argv[1] == NULL) {
+    while (reaper_pending(interpreter->job_reaper) > 0) {
+      interpreter_wait_job(interpreter);
+    }
+    while (table->count > 0) {
+      job_table_remove(table, table->jobs + table->count - 1);
+    }
+    return 0;
+  }
+  int status = 0;
+  for (char **arg = argv + 1; *arg != NULL; ++arg) {
+    Job *job = job_table_find_arg(table, *arg);
+    if (job == NULL) {
+      fprintf(env->err, "wait: %s: no such job\n", *arg);
+      status = 127;
+      continue;
+    }
+    while (job->remaining > 0) {
+      interpreter_wait_job(interpreter);
+    }
+    status = job_exit_status(job);
+    job_table_remove(table, job);
+  }
+  return status;
+}
+
+/// The inputs the parallel builtin runs its command with.
+typedef struct ParallelInputs {
+  /// The inputs given as arguments, or NULL to read them as lines instead.
+  char **list;
+  FILE *lines;
+  char *line;
+  size_t line_capacity;
+} ParallelInputs;
+
+/// Get the next input, or NULL once there are none left.
+///
+/// Empty lines are skipped.
+static char *parallel_inputs_next(ParallelInputs *inputs) {
+  if (inputs->list != NULL) {
+    return *inputs->list == NULL ? NULL : *inputs->list++;
+  }
+  if (inputs->lines == NULL) {
+    return NULL;
+  }
+  for (;;) {
+    ssize_t len = getline(&inputs->line, &inputs->line_capacity, inputs->lines);
+    if (len == -1) {
+      return NULL;
+    }
+    if (len > 0 && inputs->line[len - 1] == '\n') {
+      inputs->line[--len] = '\0';
+    }
+    if (len > 0) {
+      return inputs->line;
+    }
+  }
+}
+
+/// The state of a single run of the parallel builtin.
+typedef struct Parallel {
+  Interpreter *interpreter;
+  ParallelInputs inputs;
+  /// The arguments of each job, ending with its input.
+  char **argv;
+  size_t input_arg;
+  /// A copy of where the command was found, since a failed exec can make the
+  /// cache forget its own.
+  char *path;
+  /// What every job reads from.
+  int null_fd;
+  /// Where failures are reported.
+  FILE *err;
+  /// The job running in each slot, and where its output is collected.
+  ProcessHandleBuf *running;
+  int *outputs;
+  PipeStatus statuses;
+  size_t started;
+  size_t failed;
+} Parallel;
+
+/// Start a job in a given slot, with the next input, if there is one.
+///
+/// Inputs for which the command can't be started count as failures, and the
+/// next one is tried instead. This returns whether a job was started.
+static bool parallel_start(Parallel *p, size_t slot) {
+  char *input;
+  while ((input = parallel_inputs_next(&p->inputs)) != NULL) {
+    p->argv[p->input_arg] = input;
+    p->started++;
+    Runnable r = {.type = RUNNABLE_COMMAND,
+                  .data = {.command = {p->argv[0], p->path, p->argv,
+                                       symbol_table_environ(
+                                           p->interpreter->symbols)}}};
+    ProcessHandle handle;
+    handle.stage = slot;
+    SpawnIO io = {.stdin_fd = p->null_fd,
+                  .stdout_fd = p->outputs[slot],
+                  .redirects = NULL,
+                  .string_fds = NULL};
+    Error err = launch(r, p->interpreter->backend, &handle, &io);
+    if (err.type == ERROR_NONE) {
+      p->running->buf[slot] = handle;
+      reaper_watch(p->interpreter->reaper, handle.pid, slot);
+      return true;
+    }
+    fprintf(p->err, "parallel: %s: %s\n", p->argv[0], error_str(err));
+    p->failed++;
+  }
+  return false;
+}
+
+/// Write out the output a job collected, and empty it for the next one.
+static void parallel_flush(int fd, FILE *out) {
+  char buf[1 << 14];
+  lseek(fd, 0, SEEK_SET);
+  ssize_t count;
+  while ((count = read(fd, buf, sizeof(buf))) > 0 ||
+         (count == -1 && errno == EINTR)) {
+    if (count > 0) {
+      fwrite(buf, 1, count, out);
+    }
+  }
+  ftruncate(fd, 0);
+  lseek(fd, 0, SEEK_SET);
+}
+
+static int parallel_usage(FILE *err) {
+  fputs("parallel: usage: parallel [-j jobs] command [args...] "
+        "[::: inputs...]\n",
+        err);
+  return 2;
+}
+
+int interpreter_builtin_parallel(BuiltinEnv *env, char **argv) {
+  Interpreter *interpreter = env->interpreter;
+  char **arg = argv + 1;
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  if (*arg != NULL && strncmp(*arg, "-j", 2) == 0) {
+    // The count can either be part of the flag, or the next argument.
+    char const *count = *arg + 2;
+    if (*count == '\0') {
+      count = *++arg;
+    }
+    if (count == NULL) {
+      return parallel_usage(env->err);
+    }
+    ++arg;
+    char *end;
+    jobs = strtol(count, &end, 10);
+    if (*end != '\0' || jobs <= 0) {
+      return parallel_usage(env->err);
+    }
+  }
+  if (jobs <= 0) {
+    jobs = 1;
+  }
+  size_t command_len = 0;
+  while (arg[command_len] != NULL && strcmp(arg[command_len], ":::") != 0) {
+    ++command_len;
+  }
+  if (command_len == 0) {
+    return parallel_usage(env->err);
+  }
+
+  Parallel p = {
+      .interpreter = interpreter, .input_arg = command_len, .err = env->err};
+  char const *path = command_cache_lookup(interpreter->command_cache, arg[0]);
+  if (path == NULL) {
+    fprintf(env->err, "parallel: %s: not found\n", arg[0]);
+    return 127;
+  }
+  // Without `:::`, each line of input is an input.
+  if (arg[command_len] != NULL) {
+    p.inputs.list = arg + command_len + 1;
+  } else if (env->in != -1) {
+    int in = fcntl(env->in, F_DUPFD_CLOEXEC, 0);
+    p.inputs.lines = in == -1 ? NULL : fdopen(in, "r");
+    if (p.inputs.lines == NULL) {
+      fprintf(env->err, "parallel: %s\n", strerror(errno));
+      return 1;
+    }
+  }
+  p.path = strdup(path);
+  p.null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  p.argv = malloc((command_len + 2) * sizeof(char *));
+  p.outputs = malloc(jobs * sizeof(int));
+  if (p.path == NULL || p.argv == NULL || p.outputs == NULL) {
+    panic("interpreter: failed to allocate");
+  }
+  memcpy(p.argv, arg, command_len * sizeof(char *));
+  p.argv[command_len + 1] = NULL;
+  p.running = process_handle_buf_init();
+  p.statuses = pipe_status_init();
+
+  // The reaper for the current statement only starts watching its processes
+  // once the statement ends, so it can be borrowed until then.
+  Reaper *reaper = interpreter->reaper;
+  uint64_t start = stats_now();
+  for (size_t slot = 0; slot < (size_t)jobs; ++slot) {
+    // Every job gets its own output, so that lines from different jobs
+    // don't end up interleaved.
+    p.outputs[slot] = memfd_create("parallel", MFD_CLOEXEC);
+    if (p.outputs[slot] == -1) {
+      fprintf(env->err, "parallel: %s\n", strerror(errno));
+      break;
+    }
+    process_handle_buf_push(p.running, (ProcessHandle){.pid = -1});
+    pipe_status_push(&p.statuses, 0);
+    if (!parallel_start(&p, slot)) {
+      break;
+    }
+  }
+  while (reaper_pending(reaper) > 0) {
+    size_t slot;
+    int wstatus;
+    Error err = reaper_wait(reaper, &slot, &wstatus);
+    err = process_reaped(p.running->buf + slot, &p.statuses,
+                         interpreter->command_cache, err, wstatus);
+    if (err.type != ERROR_NONE) {
+      fprintf(env->err, "parallel: %s: %s\n", p.argv[0], error_str(err));
+    }
+    if (p.statuses.statuses[slot] != 0) {
+      p.failed++;
+    }
+    parallel_flush(p.outputs[slot], env->out);
+    parallel_start(&p, slot);
+  }
+  double seconds = (stats_now() - start) / 1e9;
+  fflush(env->out);
+  fprintf(env->err, "parallel: %zu jobs, %zu failed, %.1f jobs/s\n", p.started,
+          p.failed, seconds > 0 ? p.started / seconds : 0.0);
+
+  for (size_t slot = 0; slot < p.running->count; ++slot) {
+    close(p.outputs[slot]);
+  }
+  if (p.null_fd != -1) {
+    close(p.null_fd);
+  }
+  if (p.inputs.lines != NULL) {
+    fclose(p.inputs.lines);
+  }
+  free(p.inputs.line);
+  free(p.path);
+  free(p.argv);
+  free(p.outputs);
+  free(p.statuses.statuses);
+  process_handle_buf_free(p.running);
+  return p.failed > 0 ? 1 : 0;
+}
+
+/// Clean up after a statement, once its processes have been waited on, or
+/// moved into a job.
+void interpreter_end_statement(Interpreter *interpreter) {
+  process_handle_buf_reset(interpreter->process_buf);
+  // Nothing uses the words this statement expanded anymore, since jobs have
+  // their own copies of the names of their commands.
+  expansion_arena_reset(&interpreter->expansions);
+  // Background jobs which have exited since don't need to stay zombies.
+  interpreter_poll_jobs(interpreter, NULL);
+  trace_flush_if_full();
+  // A pipeline that failed halfway might not have consumed its last pipe.
+  if (interpreter->last_pipe_fd != -1) {
+    close(interpreter->last_pipe_fd);
+    interpreter->last_pipe_fd = -1;
+  }
+
+  // The statuses of this statement are kept around until the next one ends.
+  PipeStatus last = interpreter->last_status;
+  interpreter->last_status = interpreter->status;
+  interpreter->status = last;
+  interpreter->status.count = 0;
+  // Like in sh, a pipeline has the status of its last stage.
+  PipeStatus *ended = &interpreter->last_status;
+  interpreter->exit_status =
+      ended->count == 0 ? 0 : ended->statuses[ended->count - 1];
+}
+
+Error interpreter_wait(Interpreter *interpreter) {
+  // Processes are reaped in the order they exit, and even if one failed, the
+  // others still need to be waited on.
+  ProcessHandleBuf *processes = interpreter->process_buf;
+  uint64_t start = stats_now();
+  for (size_t i = 0; i < processes->count; ++i) {
+    reaper_watch(interpreter->reaper, processes->buf[i].pid, i);
+  }
+  Error first = (Error){ERROR_NONE};
+  while (reaper_pending(interpreter->reaper) > 0) {
+    size_t index;
+    int wstatus;
+    Error err = reaper_wait(interpreter->reaper, &index, &wstatus);
+    err = process_reaped(processes->buf + index, &interpreter->status,
+                         interpreter->command_cache, err, wstatus);
+    if (err.type != ERROR_NONE && first.type == ERROR_NONE) {
+      first = err;
+    }
+  }
+  // Output still being fed to the pipeline is done once it has exited. The
+  // writes of background jobs were already moved into their jobs.
+  pipe_writers_join(interpreter->pipe_writers);
+  if (processes->count > 0) {
+    stats_record(STATS_WAIT, start);
+  }
+  interpreter_end_statement(interpreter);
+  return first;
+}
+
+/// End a statement without waiting for it, turning its processes into a job.
+Error interpreter_background(Interpreter *interpreter) {
+  ProcessHandleBuf *processes = interpreter->process_buf;
+  // A statement made only of builtins has already finished.
+  if (processes->count > 0) {
+    Job *job = job_table_push(&interpreter->jobs, processes,
+                              &interpreter->status);
+    for (size_t i = 0; i < job->handle_count; ++i) {
+      reaper_watch(interpreter->job_reaper, job->handles[i].pid,
+                   job->first_tag + i);
+    }
+    // Writes still feeding the job are joined once it has been reaped, not
+    // by the next statement.
+    job->writers = pipe_writers_take(interpreter->pipe_writers);
+  } else {
+    // Every reader was a builtin, which has already closed its end.
+    pipe_writers_join(interpreter->pipe_writers);
+  }
+  interpreter_end_statement(interpreter);
+  // Starting a job always succeeds, whatever the job does later.
+  interpreter->exit_status = 0;
+  return (Error){ERROR_NONE};
+}
+
+/// Run a builtin with no flags, which writes straight to the shell's stdout.
+///
+/// This is the common case, and skips all of the checks for pipes and
+/// redirects in `interpreter_builtin`.
+static inline void interpreter_builtin_plain(Interpreter *interpreter,
+                                             OpDataBuiltin builtin) {
+  BuiltinSpec const *spec = builtin_spec(builtin.builtin);
+  char **argv = string_arena_get_argv(interpreter->arena, builtin.argv);
+  BuiltinEnv env = {interpreter, stdout, stderr, STDIN_FILENO};
+  pipe_status_push(&interpreter->status, spec->run(&env, argv));
+}
+
+/// Whether an operation marks the end of a statement.
+static inline bool ends_statement(OpType type) {
+  return type == OP_WAIT || type == OP_BACKGROUND;
+}
+
+/// Report an error from a statement, which doesn't stop the ones after it.
+static void report_error(Error err) {
+  fputs(error_str(err), stderr);
+  fputc('\n', stderr);
+}
+
+// With GCC and clang, operations are dispatched with computed gotos: each
+// handler jumps straight to the next one through a table of labels, instead
+// of returning to a single switch, which gives each handler its own indirect
+// branch to predict. Building with SALLY_SWITCH_DISPATCH, or with another
+// compiler, uses a plain switch in a loop instead.
+#if defined(__GNUC__) && !defined(SALLY_SWITCH_DISPATCH)
+#define SALLY_THREADED_DISPATCH
+#endif
+
+#ifdef SALLY_THREADED_DISPATCH
+#define OP_CASE(type) op_##type
+#define OP_LABEL(type) [type] = &&op_##type
+#define NEXT()                                                                 \
+  do {                                                                         \
+    if (pc >= end) {                                                           \
+      goto done;                                                               \
+    }                                                                          \
+    op = pc++;                                                                 \
+    goto *DISPATCH_TABLE[op->type];                                            \
+  } while (0)
+#else
+#define OP_CASE(type) case type
+#define NEXT() continue
+#endif
+
 Error interpreter_run(Interpreter *interpreter, OpBuffer *buf) {
-  for (size_t i = 0; i < buf->len; ++i) {
-    Error err = interpreter_op(interpreter, buf->ops[i]);
+#ifdef SALLY_THREADED_DISPATCH
+  static void *const DISPATCH_TABLE[] = {
+      OP_LABEL(OP_BUILTIN),         OP_LABEL(OP_COMMAND),
+      OP_LABEL(OP_WAIT),            OP_LABEL(OP_BACKGROUND),
+      OP_LABEL(OP_JUMP_IF_SUCCESS), OP_LABEL(OP_JUMP_IF_FAILURE),
+      OP_LABEL(OP_BUILTIN_PLAIN),   OP_LABEL(OP_COMMAND_PLAIN),
+      OP_LABEL(OP_ASSIGN),
+  };
+#endif
+  uint64_t statement_start = trace_enabled() ? stats_now() : 0;
+  bool failed = false;
+  Op const *pc = buf->ops;
+  Op const *end = buf->ops + buf->len;
+  Op const *op;
+  Error err;
+
+#ifdef SALLY_THREADED_DISPATCH
+  NEXT();
+#else
+  for (;;) {
+    if (pc >= end) {
+      goto done;
+    }
+    op = pc++;
+    switch (op->type) {
+#endif
+  OP_CASE(OP_BUILTIN_PLAIN): {
+    interpreter_builtin_plain(interpreter, op->data.builtin);
+    NEXT();
+  }
+  OP_CASE(OP_BUILTIN): {
+    err = interpreter_builtin(interpreter, op->flag, op->data.builtin);
     if (err.type != ERROR_NONE) {
-      return err;
+      goto op_failed;
+    }
+    NEXT();
+  }
+  OP_CASE(OP_COMMAND_PLAIN): {
+    err = interpreter_command(interpreter, OP_FLAG_NONE, op->data.command);
+    if (err.type != ERROR_NONE) {
+      goto op_failed;
     }
+    NEXT();
+  }
+  OP_CASE(OP_COMMAND): {
+    err = interpreter_command(interpreter, op->flag, op->data.command);
+    if (err.type != ERROR_NONE) {
+      goto op_failed;
+    }
+    NEXT();
+  }
+  OP_CASE(OP_ASSIGN): {
+    err = interpreter_assign(interpreter, op->flag, op->data.assign);
+    if (err.type != ERROR_NONE) {
+      goto op_failed;
+    }
+    NEXT();
+  }
+  OP_CASE(OP_WAIT): {
+    err = interpreter_wait(interpreter);
+    goto statement_ended;
+  }
+  OP_CASE(OP_BACKGROUND): {
+    err = interpreter_background(interpreter);
+    goto statement_ended;
+  }
+  OP_CASE(OP_JUMP_IF_SUCCESS): {
+    if (interpreter->exit_status == 0) {
+      pc = buf->ops + op->data.target;
+    }
+    NEXT();
+  }
+  OP_CASE(OP_JUMP_IF_FAILURE): {
+    if (interpreter->exit_status != 0) {
+      pc = buf->ops + op->data.target;
+    }
+    NEXT();
+  }
+#ifndef SALLY_THREADED_DISPATCH
+    }
+#endif
+  statement_ended: {
+    // A statement which failed to run fails, even if its last stage ran.
+    if ((failed || err.type != ERROR_NONE) && interpreter->exit_status == 0) {
+      interpreter->exit_status = 1;
+    }
+    failed = false;
+    if (trace_enabled()) {
+      trace_span("statement", statement_start, 0, NULL);
+      statement_start = stats_now();
+    }
+    if (err.type != ERROR_NONE) {
+      report_error(err);
+    }
+    NEXT();
+  }
+  op_failed: {
+    report_error(err);
+    // The rest of the statement is skipped, but we still wait on what it
+    // already launched, or run it in the background.
+    failed = true;
+    while (pc < end && !ends_statement(pc->type)) {
+      ++pc;
+    }
+    NEXT();
+  }
+#ifndef SALLY_THREADED_DISPATCH
+  }
+#endif
+
+done:
+  // Programs end with a statement, but anything left over is still waited on.
+  if (interpreter->process_buf->count == 0 &&
+      interpreter->status.count == 0) {
+    return (Error){ERROR_NONE};
   }
   return interpreter_wait(interpreter);
 }
 
+#undef OP_CASE
+#undef OP_LABEL
+#undef NEXT
+
+int interpreter_exit_status(Interpreter *interpreter) {
+  return interpreter->exit_status;
+}
+
 void interpreter_reset(Interpreter *interpreter) {
-  string_stack_reset(interpreter->string_stack);
   process_handle_buf_reset(interpreter->process_buf);
+  interpreter->status.count = 0;
 }
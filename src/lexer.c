@@ -1,45 +1,602 @@
-#include "ctype.h"
+#include "stdbool.h"
+#include "stdint.h"
+#include "string.h"
+#include "unistd.h"
+
+#if defined(__AVX2__)
+#include "immintrin.h"
+#elif defined(__SSE2__)
+#include "emmintrin.h"
+#endif
 
 #include "include/lexer.h"
 
-extern Lexer lexer_init(char const *input, StringArena *arena);
+extern Lexer lexer_init(StringSlice input, StringArena *arena);
+
+/// The different classes of bytes the lexer cares about.
+typedef enum CharClass {
+  /// A byte which can be part of a word, without any special treatment.
+  CLASS_WORD = 0,
+  /// Whitespace, other than line breaks, which separates tokens.
+  CLASS_SPACE,
+  CLASS_NEWLINE,
+  CLASS_PIPE,
+  CLASS_ANGLE_RIGHT,
+  CLASS_ANGLE_LEFT,
+  CLASS_AMPERSAND,
+  CLASS_SEMICOLON,
+  /// Either kind of quote, starting a quoted part of a word.
+  CLASS_QUOTE,
+  CLASS_BACKSLASH,
+  /// A `$`, which can start a substitution.
+  CLASS_DOLLAR,
+} CharClass;
+
+/// The class of each byte.
+///
+/// Anything not listed here is part of a word. The vectorized scan in
+/// `find_word_end` needs to stay in sync with this table.
+static const uint8_t CHAR_CLASSES[256] = {
+    ['\t'] = CLASS_SPACE,     ['\v'] = CLASS_SPACE,       ['\f'] = CLASS_SPACE,
+    ['\r'] = CLASS_SPACE,     [' '] = CLASS_SPACE,        ['\n'] = CLASS_NEWLINE,
+    ['|'] = CLASS_PIPE,       ['>'] = CLASS_ANGLE_RIGHT,  ['\''] = CLASS_QUOTE,
+    ['"'] = CLASS_QUOTE,      ['\\'] = CLASS_BACKSLASH,
+    ['&'] = CLASS_AMPERSAND,  [';'] = CLASS_SEMICOLON,
+    ['<'] = CLASS_ANGLE_LEFT, ['$'] = CLASS_DOLLAR,
+};
+
+static inline CharClass char_class(char c) {
+  return CHAR_CLASSES[(unsigned char)c];
+}
+
+#if defined(__AVX2__)
+/// Find the first byte in a block of 32 which doesn't belong to a plain word.
+///
+/// This returns a bitmask, with one bit set for each such byte.
+static inline uint32_t special_mask(char const *at) {
+  __m256i v = _mm256_loadu_si256((__m256i const *)at);
+  // \t, \n, \v, \f and \r are the contiguous range 9..13.
+  __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(9));
+  __m256i control = _mm256_cmpeq_epi8(
+      _mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+  __m256i special = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('|'))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('>')),
+                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\''))));
+  special = _mm256_or_si256(
+      special, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))));
+  special = _mm256_or_si256(
+      special, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('&')),
+                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';'))));
+  special = _mm256_or_si256(
+      special, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('<')),
+                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8('$'))));
+  return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(special, control));
+}
+#define SPECIAL_BLOCK 32
+#elif defined(__SSE2__)
+/// Find the first byte in a block of 16 which doesn't belong to a plain word.
+///
+/// This returns a bitmask, with one bit set for each such byte.
+static inline uint32_t special_mask(char const *at) {
+  __m128i v = _mm_loadu_si128((__m128i const *)at);
+  // \t, \n, \v, \f and \r are the contiguous range 9..13.
+  __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(9));
+  __m128i control =
+      _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+  __m128i special =
+      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                _mm_cmpeq_epi8(v, _mm_set1_epi8('|'))),
+                   _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('>')),
+                                _mm_cmpeq_epi8(v, _mm_set1_epi8('\''))));
+  special = _mm_or_si128(
+      special, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                            _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+  special = _mm_or_si128(special,
+                         _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('&')),
+                                      _mm_cmpeq_epi8(v, _mm_set1_epi8(';'))));
+  special = _mm_or_si128(special,
+                         _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('<')),
+                                      _mm_cmpeq_epi8(v, _mm_set1_epi8('$'))));
+  return (uint32_t)_mm_movemask_epi8(_mm_or_si128(special, control));
+}
+#define SPECIAL_BLOCK 16
+#endif
+
+/// Find the index of the first byte at or after start which isn't plain word.
+static inline size_t find_word_end(char const *input, size_t start,
+                                   size_t len) {
+  size_t i = start;
+#ifdef SPECIAL_BLOCK
+  for (; i + SPECIAL_BLOCK <= len; i += SPECIAL_BLOCK) {
+    uint32_t mask = special_mask(input + i);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; i < len && char_class(input[i]) == CLASS_WORD; ++i) {
+  }
+  return i;
+}
+
+/// Check if a character can be escaped with a backslash inside double quotes.
+static inline bool escapable_in_double_quotes(char c) {
+  return c == '"' || c == '\\' || c == '$' || c == '`' || c == '\n';
+}
+
+/// Whether a byte can start the name of a variable.
+static inline bool is_name_start(char c) {
+  return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/// Find where the name of a variable starting at an index ends.
+///
+/// This is the index itself if no name starts there.
+static size_t name_end(char const *input, size_t start, size_t len) {
+  if (start >= len || !is_name_start(input[start])) {
+    return start;
+  }
+  size_t i = start + 1;
+  for (; i < len && (is_name_start(input[i]) ||
+                     (input[i] >= '0' && input[i] <= '9'));
+       ++i) {
+  }
+  return i;
+}
+
+static const StringSlice TEMPLATE_SEPARATOR = {.data = "", .len = 1};
+
+/// Lex a substitution, like `$NAME`, `${NAME}`, or `$?`, starting at the `$`
+/// at index i, and moving i past it.
+///
+/// The word being built becomes a template, see `TOKEN_EXPANSION`, which this
+/// adds the name of the variable to. A `$` which isn't followed by a name is
+/// kept as is.
+static Error lex_substitution(Lexer *lexer, size_t *i, bool *expanded) {
+  char const *input = lexer->input;
+  size_t len = lexer->len;
+  size_t start = *i + 1;
+  bool braced = start < len && input[start] == '{';
+  if (braced) {
+    ++start;
+  }
+  size_t end = start < len && input[start] == '?'
+                   ? start + 1
+                   : name_end(input, start, len);
+  if (braced && (end == start || end >= len || input[end] != '}')) {
+    return (Error){ERROR_LEXER,
+                   {.lexer_error = LEXER_ERROR_BAD_SUBSTITUTION}};
+  }
+  if (end == start) {
+    string_arena_append(lexer->arena, (StringSlice){.data = "$", .len = 1});
+    *i = start;
+    return (Error){ERROR_NONE};
+  }
+  string_arena_append(lexer->arena, TEMPLATE_SEPARATOR);
+  string_arena_append(lexer->arena,
+                      (StringSlice){.data = input + start, .len = end - start});
+  string_arena_append(lexer->arena, TEMPLATE_SEPARATOR);
+  *expanded = true;
+  *i = braced ? end + 1 : end;
+  return (Error){ERROR_NONE};
+}
+
+/// Lex the rest of a word containing quotes, backslashes, or substitutions.
+///
+/// The part of the word before `index` has no special characters. The word
+/// gets unescaped, which is why it's built piece by piece in the arena, with
+/// a suffix added at the end. Substitutions are only recognized if expand is
+/// set, and otherwise, a `$` is like any other byte.
+static Error lex_complex_word(Lexer *lexer, size_t start, StringSlice suffix,
+                              bool expand, Token *out) {
+  char const *input = lexer->input;
+  size_t len = lexer->len;
+  size_t i = lexer->index;
+  bool expanded = false;
+
+  StringHandle handle = string_arena_begin(lexer->arena);
+  string_arena_append(lexer->arena,
+                      (StringSlice){.data = input + start, .len = i - start});
+  while (i < len) {
+    CharClass class = char_class(input[i]);
+    if (class == CLASS_WORD || (class == CLASS_DOLLAR && !expand)) {
+      size_t end = find_word_end(input, i + 1, len);
+      string_arena_append(lexer->arena,
+                          (StringSlice){.data = input + i, .len = end - i});
+      i = end;
+    } else if (class == CLASS_DOLLAR) {
+      Error err = lex_substitution(lexer, &i, &expanded);
+      if (err.type != ERROR_NONE) {
+        return err;
+      }
+    } else if (class == CLASS_BACKSLASH) {
+      // A backslash before a line break continues the line.
+      if (i + 1 < len && input[i + 1] != '\n') {
+        string_arena_append(lexer->arena,
+                            (StringSlice){.data = input + i + 1, .len = 1});
+      }
+      i += 2;
+    } else if (input[i] == '\'') {
+      // Nothing is special inside of single quotes.
+      char const *end = memchr(input + i + 1, '\'', len - i - 1);
+      if (end == NULL) {
+        return (Error){ERROR_LEXER,
+                       {.lexer_error = LEXER_ERROR_UNTERMINATED_QUOTE}};
+      }
+      size_t end_i = end - input;
+      string_arena_append(lexer->arena, (StringSlice){.data = input + i + 1,
+                                                      .len = end_i - i - 1});
+      i = end_i + 1;
+    } else if (input[i] == '"') {
+      for (++i;;) {
+        size_t run = i;
+        for (; i < len && input[i] != '"' && input[i] != '\\' &&
+               !(expand && input[i] == '$');
+             ++i) {
+        }
+        string_arena_append(lexer->arena,
+                            (StringSlice){.data = input + run, .len = i - run});
+        if (i >= len) {
+          return (Error){ERROR_LEXER,
+                         {.lexer_error = LEXER_ERROR_UNTERMINATED_QUOTE}};
+        }
+        if (input[i] == '"') {
+          ++i;
+          break;
+        }
+        if (input[i] == '$') {
+          Error err = lex_substitution(lexer, &i, &expanded);
+          if (err.type != ERROR_NONE) {
+            return err;
+          }
+          continue;
+        }
+        // Inside double quotes, most backslashes are kept as is.
+        if (i + 1 < len && escapable_in_double_quotes(input[i + 1])) {
+          if (input[i + 1] != '\n') {
+            string_arena_append(lexer->arena,
+                                (StringSlice){.data = input + i + 1, .len = 1});
+          }
+          i += 2;
+        } else {
+          string_arena_append(lexer->arena,
+                              (StringSlice){.data = input + i, .len = 1});
+          i += 1;
+        }
+      }
+    } else {
+      break;
+    }
+  }
+  string_arena_append(lexer->arena, suffix);
+  // An empty name ends a template.
+  if (expanded) {
+    string_arena_append(lexer->arena, TEMPLATE_SEPARATOR);
+  }
+  string_arena_end(lexer->arena);
+
+  lexer->index = i < len ? i : len;
+  lexer->command_start = false;
+  out->type = expanded ? TOKEN_EXPANSION : TOKEN_WORD;
+  out->data.string = handle;
+  return (Error){ERROR_NONE};
+}
+
+/// Check whether the byte after the current one is a given character.
+static inline bool lexer_peek_is(Lexer *lexer, char c) {
+  return lexer->index + 1 < lexer->len && lexer->input[lexer->index + 1] == c;
+}
+
+static const StringSlice NO_SUFFIX = {.data = "", .len = 0};
+static const StringSlice NEWLINE_SUFFIX = {.data = "\n", .len = 1};
+
+/// Lex the word after `<<` or `<<<`, adding a suffix to it.
+///
+/// Unlike other words, this one can't be a builtin, and `#` doesn't start a
+/// comment. Substitutions are only recognized if expand is set, for a
+/// here-string, and the delimiter of a here-document is always taken as is.
+static Error lex_here_word(Lexer *lexer, StringSlice suffix, bool expand,
+                           Token *out) {
+  while (lexer->index < lexer->len &&
+         char_class(lexer->input[lexer->index]) == CLASS_SPACE) {
+    lexer->index++;
+  }
+  CharClass class = lexer->index < lexer->len
+                        ? char_class(lexer->input[lexer->index])
+                        : CLASS_SPACE;
+  if (class != CLASS_WORD && class != CLASS_QUOTE &&
+      class != CLASS_BACKSLASH && class != CLASS_DOLLAR) {
+    return (Error){ERROR_LEXER, {.lexer_error = LEXER_ERROR_HERE_DOC_WORD}};
+  }
+  size_t start = lexer->index;
+  lexer->index = find_word_end(lexer->input, start, lexer->len);
+  return lex_complex_word(lexer, start, suffix, expand, out);
+}
+
+/// Lex the body of a here-document whose delimiter isn't quoted, between
+/// two indices.
+///
+/// Substitutions are recognized like inside of double quotes, and a
+/// backslash only escapes `$`, `` ` ``, another backslash, or a line break,
+/// but quotes are kept as is.
+static Error lex_here_body(Lexer *lexer, size_t start, size_t end,
+                           Redirect *redirect) {
+  char const *input = lexer->input;
+  bool expanded = false;
+  StringHandle handle = string_arena_begin(lexer->arena);
+  for (size_t i = start; i < end;) {
+    size_t run = i;
+    for (; i < end && input[i] != '$' && input[i] != '\\'; ++i) {
+    }
+    string_arena_append(lexer->arena,
+                        (StringSlice){.data = input + run, .len = i - run});
+    if (i >= end) {
+      break;
+    }
+    if (input[i] == '$') {
+      Error err = lex_substitution(lexer, &i, &expanded);
+      if (err.type != ERROR_NONE) {
+        return err;
+      }
+    } else if (i + 1 < end && escapable_in_double_quotes(input[i + 1]) &&
+               input[i + 1] != '"') {
+      if (input[i + 1] != '\n') {
+        string_arena_append(lexer->arena,
+                            (StringSlice){.data = input + i + 1, .len = 1});
+      }
+      i += 2;
+    } else {
+      string_arena_append(lexer->arena,
+                          (StringSlice){.data = input + i, .len = 1});
+      i += 1;
+    }
+  }
+  if (expanded) {
+    string_arena_append(lexer->arena, TEMPLATE_SEPARATOR);
+  }
+  string_arena_end(lexer->arena);
+  redirect->type = expanded ? REDIRECT_TEMPLATE : REDIRECT_STRING;
+  redirect->data.handle = handle;
+  return (Error){ERROR_NONE};
+}
+
+/// Lex a here-document, after its `<<`.
+///
+/// The delimiter comes right after, and the body starts on the next line, or
+/// after the body of the last here-document on this line, up until a line
+/// containing only the delimiter. Like in sh, if any part of the delimiter is
+/// quoted, the body is taken as is, and otherwise, it can have substitutions.
+static Error lex_here_doc(Lexer *lexer, Redirect *redirect) {
+  size_t word_start = lexer->index;
+  Token word;
+  Error err = lex_here_word(lexer, NO_SUFFIX, false, &word);
+  if (err.type != ERROR_NONE) {
+    return err;
+  }
+  bool quoted = false;
+  for (size_t i = word_start; i < lexer->index; ++i) {
+    CharClass class = char_class(lexer->input[i]);
+    quoted = quoted || class == CLASS_QUOTE || class == CLASS_BACKSLASH;
+  }
+  // Nothing gets allocated until the body has been found, so this stays valid.
+  char const *delimiter = string_arena_get_str(lexer->arena, word.data.string);
+  size_t delimiter_len = strlen(delimiter);
+
+  char const *input = lexer->input;
+  size_t len = lexer->len;
+  size_t start = lexer->here_doc_end;
+  if (start == 0) {
+    char const *newline =
+        memchr(input + lexer->index, '\n', len - lexer->index);
+    if (newline == NULL) {
+      return (Error){ERROR_LEXER,
+                     {.lexer_error = LEXER_ERROR_UNTERMINATED_HERE_DOC}};
+    }
+    start = newline - input + 1;
+  }
+  for (size_t line = start; line < len;) {
+    char const *newline = memchr(input + line, '\n', len - line);
+    size_t line_end = newline == NULL ? len : (size_t)(newline - input);
+    if (line_end - line == delimiter_len &&
+        memcmp(input + line, delimiter, delimiter_len) == 0) {
+      lexer->here_doc_end = newline == NULL ? len : line_end + 1;
+      if (!quoted) {
+        return lex_here_body(lexer, start, line, redirect);
+      }
+      StringSlice body = {.data = input + start, .len = line - start};
+      redirect->type = REDIRECT_STRING;
+      redirect->data.handle = string_arena_alloc(lexer->arena, body);
+      return (Error){ERROR_NONE};
+    }
+    line = line_end + 1;
+  }
+  return (Error){ERROR_LEXER,
+                 {.lexer_error = LEXER_ERROR_UNTERMINATED_HERE_DOC}};
+}
+
+/// Whether the byte at an index is a digit on its own, naming a descriptor.
+static inline bool lexer_is_fd(Lexer *lexer, size_t i) {
+  return i < lexer->len && lexer->input[i] >= '0' && lexer->input[i] <= '9' &&
+         (i + 1 >= lexer->len || char_class(lexer->input[i + 1]) != CLASS_WORD);
+}
+
+/// Lex a redirect, starting at its `>` or `<`.
+///
+/// The descriptor is the digit written right before the operator, like the 2
+/// in `2>`, or -1 if there was none.
+static Error lex_redirect(Lexer *lexer, int fd, Token *out) {
+  Redirect *redirect = &out->data.redirect;
+  out->type = TOKEN_REDIRECT;
+  lexer->command_start = false;
+  if (lexer->input[lexer->index] == '>') {
+    redirect->fd = fd == -1 ? STDOUT_FILENO : fd;
+    if (lexer_peek_is(lexer, '>')) {
+      redirect->type = REDIRECT_APPEND;
+      lexer->index += 2;
+    } else if (lexer_peek_is(lexer, '&') &&
+               lexer_is_fd(lexer, lexer->index + 2)) {
+      redirect->type = REDIRECT_DUP;
+      redirect->data.source_fd = lexer->input[lexer->index + 2] - '0';
+      lexer->index += 3;
+    } else {
+      redirect->type = REDIRECT_WRITE;
+      lexer->index++;
+    }
+    return (Error){ERROR_NONE};
+  }
+
+  redirect->fd = fd == -1 ? STDIN_FILENO : fd;
+  size_t count = 1;
+  while (count < 3 && lexer_peek_is(lexer, '<')) {
+    lexer->index++;
+    count++;
+  }
+  lexer->index++;
+  if (count == 1) {
+    redirect->type = REDIRECT_READ;
+    return (Error){ERROR_NONE};
+  }
+  if (count == 2) {
+    return lex_here_doc(lexer, redirect);
+  }
+  Token word;
+  Error err = lex_here_word(lexer, NEWLINE_SUFFIX, true, &word);
+  redirect->type =
+      word.type == TOKEN_EXPANSION ? REDIRECT_TEMPLATE : REDIRECT_STRING;
+  redirect->data.handle = word.data.string;
+  return err;
+}
 
 Error lexer_next(Lexer *lexer, Token *out) {
   out->type = TOKEN_EOF;
+  // The value of an assignment is always a word, even an empty one, after
+  // which another assignment, or the command, can follow.
+  if (lexer->assignment_value) {
+    lexer->assignment_value = false;
+    Error err = lex_complex_word(lexer, lexer->index, NO_SUFFIX, true, out);
+    lexer->command_start = true;
+    return err;
+  }
   // We always return, unless we continue
   for (;;) {
-    char next = lexer->input[lexer->index];
-    if (next == 0) {
+    if (lexer->index >= lexer->len) {
       out->type = TOKEN_EOF;
-    } else if (next == '>') {
-      out->type = TOKEN_ANGLE_RIGHT;
+      return (Error){ERROR_NONE};
+    }
+    char next = lexer->input[lexer->index];
+    switch (char_class(next)) {
+    case CLASS_SPACE: {
       lexer->index++;
-    } else if (next == '|') {
-      out->type = TOKEN_PIPE;
+      continue;
+    }
+    case CLASS_NEWLINE: {
+      out->type = TOKEN_NEWLINE;
+      lexer->command_start = true;
       lexer->index++;
-    } else if (isspace(next)) {
+      // The bodies of here-documents were already read, so they're skipped.
+      if (lexer->here_doc_end != 0) {
+        lexer->index = lexer->here_doc_end;
+        lexer->here_doc_end = 0;
+      }
+      break;
+    }
+    case CLASS_PIPE: {
+      bool doubled = lexer_peek_is(lexer, '|');
+      out->type = doubled ? TOKEN_OR : TOKEN_PIPE;
+      lexer->command_start = true;
+      lexer->index += doubled ? 2 : 1;
+      break;
+    }
+    case CLASS_ANGLE_RIGHT:
+    case CLASS_ANGLE_LEFT: {
+      return lex_redirect(lexer, -1, out);
+    }
+    case CLASS_AMPERSAND: {
+      bool doubled = lexer_peek_is(lexer, '&');
+      out->type = doubled ? TOKEN_AND : TOKEN_AMPERSAND;
+      lexer->command_start = true;
+      lexer->index += doubled ? 2 : 1;
+      break;
+    }
+    case CLASS_SEMICOLON: {
+      out->type = TOKEN_SEMICOLON;
+      lexer->command_start = true;
       lexer->index++;
-      continue;
-    } else {
-      // Simplest to just assume that everything else starts a word
+      break;
+    }
+    case CLASS_BACKSLASH: {
+      // A backslash before a line break continues the line.
+      if (lexer->index + 1 < lexer->len &&
+          lexer->input[lexer->index + 1] == '\n') {
+        lexer->index += 2;
+        continue;
+      }
+      return lex_complex_word(lexer, lexer->index, NO_SUFFIX, true, out);
+    }
+    case CLASS_QUOTE:
+    case CLASS_DOLLAR: {
+      return lex_complex_word(lexer, lexer->index, NO_SUFFIX, true, out);
+    }
+    case CLASS_WORD: {
+      // Comments run until the end of the line, which is still a token.
+      if (next == '#') {
+        char const *end = memchr(lexer->input + lexer->index, '\n',
+                                 lexer->len - lexer->index);
+        lexer->index = end == NULL ? lexer->len : (size_t)(end - lexer->input);
+        continue;
+      }
+
       size_t start = lexer->index;
-      for (; next != 0 && !isspace(next); next = lexer->input[++lexer->index]) {
+      lexer->index = find_word_end(lexer->input, start, lexer->len);
+      // At the start of a command, `NAME=` assigns to a variable, whose value
+      // is the next token.
+      if (lexer->command_start) {
+        size_t equals = name_end(lexer->input, start, lexer->index);
+        if (equals > start && equals < lexer->index &&
+            lexer->input[equals] == '=') {
+          StringSlice name = {.data = lexer->input + start,
+                              .len = equals - start};
+          out->type = TOKEN_ASSIGNMENT;
+          out->data.string = string_arena_alloc(lexer->arena, name);
+          lexer->index = equals + 1;
+          lexer->assignment_value = true;
+          return (Error){ERROR_NONE};
+        }
+      }
+      if (lexer->index < lexer->len) {
+        CharClass class = char_class(lexer->input[lexer->index]);
+        if (class == CLASS_QUOTE || class == CLASS_BACKSLASH ||
+            class == CLASS_DOLLAR) {
+          return lex_complex_word(lexer, start, NO_SUFFIX, true, out);
+        }
+        // A single digit right before a redirect is the descriptor it's for.
+        if ((class == CLASS_ANGLE_RIGHT || class == CLASS_ANGLE_LEFT) &&
+            lexer->index == start + 1 && next >= '0' && next <= '9') {
+          return lex_redirect(lexer, next - '0', out);
+        }
       }
-      size_t len = lexer->index - start;
 
-      StringSlice slice = {.data = lexer->input + start, .len = len};
+      StringSlice slice = {.data = lexer->input + start,
+                           .len = lexer->index - start};
 
-      if (stringslice_cmp_str(slice, "pwd") == 0) {
-        out->type = TOKEN_BUILTIN;
-        out->data.builtin = BUILTIN_PWD;
-      } else if (stringslice_cmp_str(slice, "cd") == 0) {
+      // Quoted words never get here, so they're never treated as builtins.
+      // Neither are arguments, so that `echo cd` prints "cd".
+      Builtin builtin;
+      bool command_start = lexer->command_start;
+      lexer->command_start = false;
+      if (command_start && builtin_lookup(slice, &builtin)) {
         out->type = TOKEN_BUILTIN;
-        out->data.builtin = BUILTIN_CD;
+        out->data.builtin = builtin;
       } else {
         StringHandle handle = string_arena_alloc(lexer->arena, slice);
         out->type = TOKEN_WORD;
         out->data.string = handle;
       }
+      break;
+    }
     }
     return (Error){ERROR_NONE};
   }
@@ -0,0 +1,116 @@
+#include "errno.h"
+#include "string.h"
+#include "unistd.h"
+
+#include "include/line_reader.h"
+
+/// The smallest amount of space we ask `read` to fill at once.
+const size_t LINE_READER_CHUNK_SIZE = 1 << 16;
+
+struct LineReader {
+  int fd;
+  char *data;
+  size_t capacity;
+  /// The start of the input which hasn't been handed out yet.
+  size_t start;
+  /// The start of the last line handed out.
+  size_t line_start;
+  /// The end of the input read so far.
+  size_t end;
+  bool eof;
+};
+
+LineReader *line_reader_init(int fd) {
+  LineReader *out = malloc(sizeof(LineReader));
+  if (out == NULL) {
+    panic("line_reader: failed to allocate memory");
+  }
+  out->data = malloc(LINE_READER_CHUNK_SIZE);
+  if (out->data == NULL) {
+    panic("line_reader: failed to allocate memory");
+  }
+  out->fd = fd;
+  out->capacity = LINE_READER_CHUNK_SIZE;
+  out->start = 0;
+  out->line_start = 0;
+  out->end = 0;
+  out->eof = false;
+  return out;
+}
+
+void line_reader_free(LineReader *reader) {
+  free(reader->data);
+  free(reader);
+}
+
+/// Make room for at least a chunk of input after the end of the buffer.
+///
+/// Input which was already handed out gets dropped, and the buffer only grows
+/// once the line being read takes up most of it.
+static void line_reader_reserve(LineReader *reader) {
+  if (reader->capacity - reader->end >= LINE_READER_CHUNK_SIZE) {
+    return;
+  }
+  size_t len = reader->end - reader->start;
+  memmove(reader->data, reader->data + reader->start, len);
+  reader->start = 0;
+  reader->end = len;
+  if (reader->capacity - len >= LINE_READER_CHUNK_SIZE) {
+    return;
+  }
+  size_t new_capacity = reader->capacity;
+  while (new_capacity - len < LINE_READER_CHUNK_SIZE) {
+    new_capacity *= 2;
+  }
+  char *new_data = realloc(reader->data, new_capacity);
+  if (new_data == NULL) {
+    panic("line_reader: failed to allocate memory");
+  }
+  reader->data = new_data;
+  reader->capacity = new_capacity;
+}
+
+/// Hand out the input up to the next line break, past the first skip bytes.
+static Error line_reader_take(LineReader *reader, size_t skip,
+                              StringSlice *out, bool *eof_out) {
+  // How far past the start we've already looked for a line break.
+  size_t scanned = skip;
+  for (;;) {
+    char *line = reader->data + reader->start;
+    size_t len = reader->end - reader->start;
+    char *newline = memchr(line + scanned, '\n', len - scanned);
+    // At the end, whatever is left is the last line.
+    if (newline != NULL || reader->eof) {
+      size_t line_len = newline != NULL ? (size_t)(newline - line) + 1 : len;
+      reader->line_start = reader->start;
+      reader->start += line_len;
+      *out = (StringSlice){.data = line, .len = line_len};
+      *eof_out = line_len == skip;
+      return (Error){ERROR_NONE};
+    }
+    scanned = len;
+
+    line_reader_reserve(reader);
+    ssize_t count = read(reader->fd, reader->data + reader->end,
+                         reader->capacity - reader->end);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return error_from_errno(errno);
+    }
+    reader->eof = count == 0;
+    reader->end += count;
+  }
+}
+
+Error line_reader_next(LineReader *reader, StringSlice *out, bool *eof_out) {
+  return line_reader_take(reader, 0, out, eof_out);
+}
+
+Error line_reader_extend(LineReader *reader, StringSlice *out,
+                         bool *eof_out) {
+  size_t skip = reader->start - reader->line_start;
+  reader->start = reader->line_start;
+  return line_reader_take(reader, skip, out, eof_out);
+}
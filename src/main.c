@@ -1,5 +1,6 @@
 #include "assert.h"
 #include "errno.h"
+#include "fcntl.h"
 #include "stdbool.h"
 #include "unistd.h"
 #include "stdio.h"
@@ -9,68 +10,167 @@
 #include "include/error.h"
 #include "include/interpreter.h"
 #include "include/lexer.h"
+#include "include/line_reader.h"
 #include "include/parser.h"
+#include "include/script.h"
+#include "include/stats.h"
+#include "include/symbol_table.h"
+#include "include/trace.h"
 
-/// The number of bytes in our line buffer.
-const size_t LINE_BUFFER_SIZE = (1 << 14);
+extern char **environ;
 
 // The prompt to display in the shell.
 const char *PROMPT = ">> ";
 
-Error handle_line(StringArena *arena, Interpreter *interpreter,
-                  OpBuffer *op_buffer, char const *line) {
+// The prompt to display for lines continuing a statement.
+const char *CONTINUATION_PROMPT = "> ";
+
+Error handle_line(StringArena *arena, SymbolTable *symbols,
+                  Interpreter *interpreter, OpBuffer *op_buffer,
+                  StringSlice line) {
 
   interpreter_reset(interpreter);
 
   Error error = (Error){ERROR_NONE};
 
   Lexer lexer = lexer_init(line, arena);
-  Parser *parser = parser_init(&lexer);
+  Parser parser = parser_init(&lexer, NULL);
 
-  ASTNode node;
-  error = parser_parse(parser, &node);
+  uint64_t start = stats_now();
+  error = compile_direct(&parser, op_buffer);
+  stats_record(STATS_PARSE, start);
+  trace_span("compile", start, 0, NULL);
   if (error.type != ERROR_NONE) {
-    goto err;
+    return error;
   }
+  op_buffer_link(op_buffer, arena, symbols);
 
-  error = compile(&node, op_buffer);
-  if (error.type != ERROR_NONE) {
-    goto err;
-  }
+  return interpreter_run(interpreter, op_buffer);
+}
 
-  error = interpreter_run(interpreter, op_buffer);
+/// Run a script, reading it from a file, or from stdin if path is NULL.
+///
+/// This returns the exit code for the shell, which is the status of the last
+/// statement, like in sh.
+int run_script(StringArena *arena, SymbolTable *symbols,
+               Interpreter *interpreter, OpBuffer *op_buffer,
+               char const *path) {
+  int fd = STDIN_FILENO;
+  if (path != NULL) {
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      perror(path);
+      return 1;
+    }
+  }
 
-err:
-  ast_free(&node);
-  parser_free(parser);
-  return error;
+  Script script;
+  Error error = script_open(fd, &script);
+  if (path != NULL) {
+    close(fd);
+  }
+  if (error.type == ERROR_NONE) {
+    error = script_run(path, &script, arena, symbols, interpreter, op_buffer);
+    script_close(&script);
+  }
+  if (error.type != ERROR_NONE) {
+    fputs(error_str(error), stderr);
+    fputc('\n', stderr);
+    return 1;
+  }
+  return interpreter_exit_status(interpreter);
 }
 
-int main() {
-  char line_buffer[LINE_BUFFER_SIZE];
-  StringArena *arena = string_arena_init();
-  Interpreter *interpreter = interpreter_init(arena);
-  OpBuffer *op_buffer = op_buffer_init();
+/// Whether a line ended in the middle of a quote or a here-document, which
+/// continues on the lines after it.
+static bool line_incomplete(Error error) {
+  return error.type == ERROR_LEXER &&
+         (error.data.lexer_error == LEXER_ERROR_UNTERMINATED_QUOTE ||
+          error.data.lexer_error == LEXER_ERROR_UNTERMINATED_HERE_DOC);
+}
 
+/// Run commands from a terminal, until the end of the input.
+///
+/// This returns the exit code for the shell, like `run_script`.
+int run_interactive(StringArena *arena, SymbolTable *symbols,
+                    Interpreter *interpreter, OpBuffer *op_buffer) {
+  // Lines are read straight from stdin, so they can be as long as needed.
+  LineReader *reader = line_reader_init(STDIN_FILENO);
+  int status = 0;
   for (;;) {
+    interpreter_poll_jobs(interpreter, stderr);
     fputs(PROMPT, stdout);
-    if (fgets(line_buffer, LINE_BUFFER_SIZE, stdin) == NULL) {
-      if (feof(stdin)) {
-        break;
-      }
-      perror("Error reading line:");
-      continue;
+    // Nothing reads from stdio's stdin anymore, which used to flush this.
+    fflush(stdout);
+    StringSlice line;
+    bool eof;
+    Error error = line_reader_next(reader, &line, &eof);
+    if (error.type != ERROR_NONE) {
+      fputs(error_str(error), stderr);
+      fputc('\n', stderr);
+      status = 1;
+      break;
+    }
+    if (eof) {
+      status = interpreter_exit_status(interpreter);
+      break;
     }
     op_buffer_reset(op_buffer);
     string_arena_reset(arena);
-    Error error = handle_line(arena, interpreter, op_buffer, line_buffer);
+    error = handle_line(arena, symbols, interpreter, op_buffer, line);
+    // Nothing has run yet, so the line can be compiled again, with the next.
+    while (line_incomplete(error)) {
+      fputs(CONTINUATION_PROMPT, stdout);
+      fflush(stdout);
+      Error read_error = line_reader_extend(reader, &line, &eof);
+      if (read_error.type != ERROR_NONE) {
+        error = read_error;
+        break;
+      }
+      if (eof) {
+        break;
+      }
+      op_buffer_reset(op_buffer);
+      string_arena_reset(arena);
+      error = handle_line(arena, symbols, interpreter, op_buffer, line);
+    }
     if (error.type != ERROR_NONE) {
       fputs(error_str(error), stderr);
       fputc('\n', stderr);
     }
   }
+  line_reader_free(reader);
+  return status;
+}
+
+int main(int argc, char **argv) {
+  trace_init();
+  StringArena *arena = string_arena_init();
+  // Variables live as long as the shell, unlike the arena, which is reset for
+  // each line.
+  SymbolTable *symbols = symbol_table_init();
+  symbol_table_import(symbols, environ);
+  Interpreter *interpreter = interpreter_init(arena, symbols);
+  OpBuffer *op_buffer = op_buffer_init();
+
+  // Without a terminal to prompt, stdin is read as a script.
+  int status = 0;
+  if (argc > 1) {
+    status = run_script(arena, symbols, interpreter, op_buffer, argv[1]);
+  } else if (!isatty(STDIN_FILENO)) {
+    status = run_script(arena, symbols, interpreter, op_buffer, NULL);
+  } else {
+    status = run_interactive(arena, symbols, interpreter, op_buffer);
+  }
+
+  if (stats_dump_enabled()) {
+    stats_print(stderr);
+  }
+  trace_finish();
 
   string_arena_free(arena);
   interpreter_free(interpreter);
+  symbol_table_free(symbols);
   op_buffer_free(op_buffer);
+  return status;
 }
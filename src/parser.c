@@ -3,37 +3,7 @@
 #include "stdbool.h"
 #include "stddef.h"
 
-void ast_free(ASTNode *node) {
-  for (size_t i = 0; i < node->count; i++) {
-    ast_free(node->children + i);
-  }
-  if (node->count > 0) {
-    free(node->children);
-  }
-}
-
-const size_t DEFAULT_CHILD_COUNT = 4;
-
-struct Parser {
-  Lexer *lexer;
-  Token peek;
-  bool has_peek;
-  Token prev;
-};
-
-Parser *parser_init(Lexer *lexer) {
-  Parser *out = malloc(sizeof(Parser));
-  if (out == NULL) {
-    panic("parser_init: failed to allocate memory");
-  }
-  out->lexer = lexer;
-  out->has_peek = false;
-  return out;
-}
-
-void parser_free(Parser *parser) {
-  free(parser);
-}
+extern Parser parser_init(Lexer *lexer, ASTArena *arena);
 
 Error parse_peek(Parser *parser, Token *out) {
   if (!parser->has_peek) {
@@ -76,18 +46,106 @@ Error parse_consume(Parser *parser, TokenType type) {
   return (Error){ERROR_NONE};
 }
 
+Error parse_check_word(Parser *parser, bool *out) {
+  Token peek;
+  Error err = parse_peek(parser, &peek);
+  if (err.type != ERROR_NONE) {
+    return err;
+  }
+  *out = peek.type == TOKEN_WORD || peek.type == TOKEN_EXPANSION;
+  return (Error){ERROR_NONE};
+}
+
 Error parse_arg(Parser *parser, ASTNode *out) {
-  Error err = parse_consume(parser, TOKEN_WORD);
+  bool is_word;
+  Error err = parse_check_word(parser, &is_word);
   if (err.type != ERROR_NONE) {
     return err;
   }
-  out->type = AST_ARG;
+  if (!is_word) {
+    return (Error){ERROR_PARSER,
+                   {.parser_error = PARSER_ERROR_UNEXPECTED_TOKEN}};
+  }
+  parse_advance(parser);
+  out->type = parser->prev.type == TOKEN_EXPANSION ? AST_EXPANSION : AST_ARG;
   out->count = 0;
+  out->children = NULL;
   out->data.string = parser->prev.data.string;
 
   return (Error){ERROR_NONE};
 }
 
+Error parse_command(Parser *parser, ASTNode *out);
+
+/// Parse a command made only of assignments, like `A=1 B=$A`, or a command
+/// with assignments before it, like `A=1 cmd`.
+Error parse_assignments(Parser *parser, ASTNode *out) {
+  size_t mark = ast_arena_mark(parser->arena);
+  for (;;) {
+    Token peek;
+    Error err = parse_peek(parser, &peek);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    if (peek.type != TOKEN_ASSIGNMENT) {
+      break;
+    }
+    parse_advance(parser);
+    // The lexer always follows an assignment with its value.
+    ASTNode value;
+    if ((err = parse_arg(parser, &value)).type != ERROR_NONE) {
+      return err;
+    }
+    size_t value_mark = ast_arena_mark(parser->arena);
+    ast_arena_push(parser->arena, value);
+    ast_arena_push(parser->arena,
+                   (ASTNode){.type = AST_VARIABLE,
+                             .count = 1,
+                             .children =
+                                 ast_arena_commit(parser->arena, value_mark),
+                             .data = {.string = peek.data.string}});
+  }
+  Token peek;
+  Error err = parse_peek(parser, &peek);
+  if (err.type != ERROR_NONE) {
+    return err;
+  }
+  out->type = AST_ASSIGN;
+  if (peek.type == TOKEN_BUILTIN || peek.type == TOKEN_WORD ||
+      peek.type == TOKEN_EXPANSION) {
+    ASTNode command;
+    if ((err = parse_command(parser, &command)).type != ERROR_NONE) {
+      return err;
+    }
+    ast_arena_push(parser->arena, command);
+    out->type = AST_OVERLAY;
+  }
+  out->count = ast_arena_mark(parser->arena) - mark;
+  out->children = ast_arena_commit(parser->arena, mark);
+  return (Error){ERROR_NONE};
+}
+
+Error parse_redirect(Parser *parser, bool *found_out, Redirect *out) {
+  Token peek;
+  Error err = parse_peek(parser, &peek);
+  if (err.type != ERROR_NONE) {
+    return err;
+  }
+  *found_out = peek.type == TOKEN_REDIRECT;
+  if (!*found_out) {
+    return (Error){ERROR_NONE};
+  }
+  parse_advance(parser);
+  *out = peek.data.redirect;
+  if (redirect_opens_file(out->type)) {
+    if ((err = parse_consume(parser, TOKEN_WORD)).type != ERROR_NONE) {
+      return err;
+    }
+    out->data.handle = parser->prev.data.string;
+  }
+  return (Error){ERROR_NONE};
+}
+
 Error parse_command(Parser *parser, ASTNode *out) {
   Error err;
 
@@ -96,12 +154,13 @@ Error parse_command(Parser *parser, ASTNode *out) {
     return err;
   }
 
+  size_t mark = ast_arena_mark(parser->arena);
   switch (peek.type) {
   case TOKEN_BUILTIN: {
     parse_advance(parser);
 
     out->type = AST_BUILTIN;
-    out->builtin = peek.data.builtin;
+    out->data.builtin = peek.data.builtin;
     break;
   }
   case TOKEN_WORD: {
@@ -111,76 +170,85 @@ Error parse_command(Parser *parser, ASTNode *out) {
     out->data.string = peek.data.string;
     break;
   }
+  case TOKEN_EXPANSION: {
+    // The name is only known once expanded, so it goes with the arguments.
+    ASTNode name;
+    if ((err = parse_arg(parser, &name)).type != ERROR_NONE) {
+      return err;
+    }
+    ast_arena_push(parser->arena, name);
+    out->type = AST_COMMAND;
+    out->data.string = STRING_HANDLE_NULL;
+    break;
+  }
+  case TOKEN_ASSIGNMENT: {
+    // A command made only of assignments can't have redirects.
+    return parse_assignments(parser, out);
+  }
   default: {
     return (Error){ERROR_PARSER,
                    {.parser_error = PARSER_ERROR_UNEXPECTED_TOKEN}};
   }
   }
 
-  out->count = 0;
-  size_t capacity = DEFAULT_CHILD_COUNT;
-  out->children = malloc(capacity * sizeof(ASTNode));
-
   // Parse a list of arguments while we see words.
   bool is_word;
   for (;;) {
-    err = parse_check(parser, TOKEN_WORD, &is_word);
+    err = parse_check_word(parser, &is_word);
     if (err.type != ERROR_NONE) {
       return err;
     }
     if (!is_word) {
       break;
     }
-    size_t next_count = out->count + 1;
-    while (next_count > capacity) {
-      capacity *= 2;
-      out->children = realloc(out->children, capacity * sizeof(ASTNode));
-    }
-    err = parse_arg(parser, out->children + out->count);
+    ASTNode arg;
+    err = parse_arg(parser, &arg);
     if (err.type != ERROR_NONE) {
       return err;
     }
-    out->count = next_count;
+    ast_arena_push(parser->arena, arg);
   }
+  out->count = ast_arena_mark(parser->arena) - mark;
+  out->children = ast_arena_commit(parser->arena, mark);
 
-  // If we see a `>`, then we know that there's a redirection, and expect an
-  // arg.
-  bool is_angle_right;
-  err = parse_check(parser, TOKEN_ANGLE_RIGHT, &is_angle_right);
-  if (err.type != ERROR_NONE) {
-    return err;
-  }
-  if (!is_angle_right) {
-    return (Error){ERROR_NONE};
+  // Redirects come after the arguments, each one becoming another child of a
+  // redirect node, after the command itself.
+  mark = ast_arena_mark(parser->arena);
+  ast_arena_push(parser->arena, *out);
+  for (;;) {
+    ASTNode redirect = {.type = AST_REDIRECTION, .count = 0, .children = NULL};
+    bool found;
+    err = parse_redirect(parser, &found, &redirect.data.redirect);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    if (!found) {
+      break;
+    }
+    ast_arena_push(parser->arena, redirect);
   }
-  parse_advance(parser);
 
-  // A bit of annoying book-keeping. We've already written a node for the
-  // command, but now that node needs to become one of two children.
-  ASTNode *children = malloc(2 * sizeof(ASTNode));
-  memcpy(children, out, sizeof(ASTNode));
-  err = parse_arg(parser, children + 1);
-  if (err.type != ERROR_NONE) {
-    return err;
+  size_t count = ast_arena_mark(parser->arena) - mark;
+  if (count <= 1) {
+    *out = ast_arena_pop(parser->arena);
+    return (Error){ERROR_NONE};
   }
-
   out->type = AST_REDIRECT;
-  out->count = 2;
-  out->children = children;
+  out->count = count;
+  out->children = ast_arena_commit(parser->arena, mark);
 
   return (Error){ERROR_NONE};
 }
 
 Error parse_pipes(Parser *parser, ASTNode *out) {
-  size_t capacity = 2;
-  size_t count = 0;
-  ASTNode *children = malloc(capacity * sizeof(ASTNode));
+  size_t mark = ast_arena_mark(parser->arena);
 
-  Error err = parse_command(parser, children + count);
+  ASTNode command;
+  Error err = parse_command(parser, &command);
   if (err.type != ERROR_NONE) {
     return err;
   }
-  count++;
+  ast_arena_push(parser->arena, command);
 
   bool is_pipe;
   for (;;) {
@@ -193,34 +261,132 @@ Error parse_pipes(Parser *parser, ASTNode *out) {
     }
     parse_advance(parser);
 
-    size_t required = count + 1;
-    while (capacity < required) {
-      capacity *= 2;
-      children = realloc(children, capacity * sizeof(ASTNode));
-    }
-
-    err = parse_command(parser, children + count);
+    err = parse_command(parser, &command);
     if (err.type != ERROR_NONE) {
       return err;
     }
-    count++;
+    ast_arena_push(parser->arena, command);
   }
 
+  size_t count = ast_arena_mark(parser->arena) - mark;
   if (count <= 1) {
-    memcpy(out, children, sizeof(ASTNode));
-    free(children);
+    *out = ast_arena_pop(parser->arena);
     return (Error){ERROR_NONE};
   }
 
   out->type = AST_PIPE;
   out->count = count;
-  out->children = children;
+  out->children = ast_arena_commit(parser->arena, mark);
+
+  return (Error){ERROR_NONE};
+}
+
+Error parse_skip_newlines(Parser *parser, bool *eof_out) {
+  for (;;) {
+    Token peek;
+    Error err = parse_peek(parser, &peek);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    if (peek.type != TOKEN_NEWLINE) {
+      *eof_out = peek.type == TOKEN_EOF;
+      return (Error){ERROR_NONE};
+    }
+    parse_advance(parser);
+  }
+}
+
+Error parse_and_or(Parser *parser, ASTNode *out) {
+  Error err = parse_pipes(parser, out);
+  if (err.type != ERROR_NONE) {
+    return err;
+  }
+  // These are left associative, so what we've parsed so far becomes the left
+  // side of the next operator.
+  for (;;) {
+    Token peek;
+    if ((err = parse_peek(parser, &peek)).type != ERROR_NONE) {
+      return err;
+    }
+    if (peek.type != TOKEN_AND && peek.type != TOKEN_OR) {
+      return (Error){ERROR_NONE};
+    }
+    parse_advance(parser);
+    // The operator can end a line, with the statement continuing on the next.
+    bool eof;
+    if ((err = parse_skip_newlines(parser, &eof)).type != ERROR_NONE) {
+      return err;
+    }
+    ASTNode right;
+    if ((err = parse_pipes(parser, &right)).type != ERROR_NONE) {
+      return err;
+    }
+    size_t mark = ast_arena_mark(parser->arena);
+    ast_arena_push(parser->arena, *out);
+    ast_arena_push(parser->arena, right);
+    out->type = peek.type == TOKEN_AND ? AST_AND : AST_OR;
+    out->count = 2;
+    out->children = ast_arena_commit(parser->arena, mark);
+  }
+}
 
+Error parse_sequence(Parser *parser, ASTNode *out) {
+  size_t mark = ast_arena_mark(parser->arena);
+  for (;;) {
+    bool eof;
+    Error err = parse_skip_newlines(parser, &eof);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    if (eof) {
+      break;
+    }
+
+    ASTNode statement;
+    err = parse_and_or(parser, &statement);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+
+    // Each statement needs to end with a line break, a semicolon, or the
+    // input, unless it runs in the background, in which case another
+    // statement can follow.
+    Token peek;
+    err = parse_peek(parser, &peek);
+    if (err.type != ERROR_NONE) {
+      return err;
+    }
+    if (peek.type == TOKEN_AMPERSAND) {
+      if (statement.type == AST_AND || statement.type == AST_OR) {
+        return (Error){ERROR_PARSER,
+                       {.parser_error = PARSER_ERROR_BACKGROUND_LIST}};
+      }
+      parse_advance(parser);
+      size_t child_mark = ast_arena_mark(parser->arena);
+      ast_arena_push(parser->arena, statement);
+      statement = (ASTNode){.type = AST_BACKGROUND,
+                            .count = 1,
+                            .children =
+                                ast_arena_commit(parser->arena, child_mark)};
+      ast_arena_push(parser->arena, statement);
+      continue;
+    }
+    ast_arena_push(parser->arena, statement);
+    if (peek.type == TOKEN_SEMICOLON) {
+      parse_advance(parser);
+      continue;
+    }
+    if (peek.type != TOKEN_NEWLINE && peek.type != TOKEN_EOF) {
+      return (Error){ERROR_PARSER,
+                     {.parser_error = PARSER_ERROR_UNEXPECTED_TOKEN}};
+    }
+  }
+  out->type = AST_SEQUENCE;
+  out->count = ast_arena_mark(parser->arena) - mark;
+  out->children = ast_arena_commit(parser->arena, mark);
   return (Error){ERROR_NONE};
 }
 
 Error parser_parse(Parser *parser, ASTNode *out) {
-  // Just initialize this so that the node can be freed even if we error.
-  out->count = 0;
-  return parse_pipes(parser, out);
+  return parse_sequence(parser, out);
 }
@@ -0,0 +1,278 @@
+// For fopencookie.
+#define _GNU_SOURCE
+
+#include "errno.h"
+#include "fcntl.h"
+#include "pthread.h"
+#include "signal.h"
+#include "stdbool.h"
+#include "unistd.h"
+
+#include "include/pipe_writer.h"
+
+/// The write end of a pipe, which a builtin writes its output into.
+///
+/// Until the pipe fills up, the stream writes into it directly, without a
+/// thread. Past that, whatever the builtin writes is queued, and a helper
+/// thread writes it into the pipe as the next stage reads it.
+typedef struct PipeWrite {
+  PipeWriters *writers;
+  int fd;
+  /// Whether the helper thread was started, after which the fields below are
+  /// shared with it, under the lock.
+  bool threaded;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  /// The output queued for the helper thread, not written yet.
+  char *data;
+  size_t len;
+  size_t capacity;
+  /// Whether the stream was closed, so that nothing else will be queued.
+  bool closed;
+  /// Whether the reader went away, after which output is thrown away.
+  bool broken;
+} PipeWrite;
+
+struct PipeWriters {
+  /// The ongoing writes, each of which is allocated separately, since their
+  /// threads hold on to them.
+  PipeWrite **writes;
+  size_t count;
+  size_t capacity;
+};
+
+const size_t PIPE_WRITERS_START_CAPACITY = 4;
+/// The size of the first buffer queuing output for a helper thread.
+const size_t PIPE_WRITE_START_CAPACITY = 1 << 16;
+
+PipeWriters *pipe_writers_init() {
+  PipeWriters *out = malloc(sizeof(PipeWriters));
+  if (out == NULL) {
+    panic("pipe_writers_init: failed to allocate memory");
+  }
+  out->count = 0;
+  out->capacity = PIPE_WRITERS_START_CAPACITY;
+  out->writes = malloc(out->capacity * sizeof(PipeWrite *));
+  if (out->writes == NULL) {
+    panic("pipe_writers_init: failed to allocate memory");
+  }
+  return out;
+}
+
+void pipe_writers_free(PipeWriters *writers) {
+  pipe_writers_join(writers);
+  free(writers->writes);
+  free(writers);
+}
+
+/// Write everything, stopping early if the reader goes away.
+///
+/// This returns false if not everything could be written.
+static bool write_all(int fd, char const *data, size_t len) {
+  while (len > 0) {
+    ssize_t count = write(fd, data, len);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += count;
+    len -= count;
+  }
+  return true;
+}
+
+static void *pipe_write_run(void *arg) {
+  PipeWrite *pipe_write = arg;
+  // If the reader exits early, the SIGPIPE is sent to this thread only, and
+  // blocking it here means it never kills the shell.
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+  // Only this thread writes from now on, and it can wait for the reader.
+  int flags = fcntl(pipe_write->fd, F_GETFL);
+  fcntl(pipe_write->fd, F_SETFL, flags & ~O_NONBLOCK);
+
+  pthread_mutex_lock(&pipe_write->lock);
+  for (;;) {
+    while (pipe_write->len == 0 && !pipe_write->closed) {
+      pthread_cond_wait(&pipe_write->ready, &pipe_write->lock);
+    }
+    if (pipe_write->len == 0) {
+      break;
+    }
+    // The builtin queues into a fresh buffer while this one is written.
+    char *data = pipe_write->data;
+    size_t len = pipe_write->len;
+    pipe_write->data = NULL;
+    pipe_write->len = 0;
+    pipe_write->capacity = 0;
+    pthread_mutex_unlock(&pipe_write->lock);
+    bool written = write_all(pipe_write->fd, data, len);
+    free(data);
+    pthread_mutex_lock(&pipe_write->lock);
+    pipe_write->broken = pipe_write->broken || !written;
+  }
+  pthread_mutex_unlock(&pipe_write->lock);
+  close(pipe_write->fd);
+  return NULL;
+}
+
+/// Keep track of a write whose thread was started, to join it later.
+static void pipe_writers_push(PipeWriters *writers, PipeWrite *pipe_write) {
+  if (writers->count >= writers->capacity) {
+    writers->capacity *= 2;
+    writers->writes =
+        realloc(writers->writes, writers->capacity * sizeof(PipeWrite *));
+    if (writers->writes == NULL) {
+      panic("pipe_writers: failed to allocate memory");
+    }
+  }
+  writers->writes[writers->count++] = pipe_write;
+}
+
+/// Queue output for the helper thread, which must have been started.
+static void pipe_write_queue(PipeWrite *pipe_write, char const *data,
+                             size_t len) {
+  pthread_mutex_lock(&pipe_write->lock);
+  if (!pipe_write->broken) {
+    if (pipe_write->len + len > pipe_write->capacity) {
+      size_t capacity = pipe_write->capacity == 0 ? PIPE_WRITE_START_CAPACITY
+                                                  : pipe_write->capacity;
+      while (capacity < pipe_write->len + len) {
+        capacity *= 2;
+      }
+      pipe_write->data = realloc(pipe_write->data, capacity);
+      if (pipe_write->data == NULL) {
+        panic("pipe_writers: failed to allocate memory");
+      }
+      pipe_write->capacity = capacity;
+    }
+    memcpy(pipe_write->data + pipe_write->len, data, len);
+    pipe_write->len += len;
+    pthread_cond_signal(&pipe_write->ready);
+  }
+  pthread_mutex_unlock(&pipe_write->lock);
+}
+
+/// Write output from the builtin's stream, starting the helper thread once
+/// the pipe is full.
+static ssize_t pipe_write_stream(void *cookie, char const *data, size_t len) {
+  PipeWrite *pipe_write = cookie;
+  if (pipe_write->threaded) {
+    pipe_write_queue(pipe_write, data, len);
+    return len;
+  }
+  // The shell still holds the read end while the builtin runs, so this can
+  // only stop once the pipe is full.
+  size_t done = 0;
+  while (done < len) {
+    ssize_t count = write(pipe_write->fd, data + done, len - done);
+    if (count >= 0) {
+      done += count;
+    } else if (errno != EINTR) {
+      break;
+    }
+  }
+  if (done == len) {
+    return len;
+  }
+  if (errno != EAGAIN) {
+    return -1;
+  }
+  int errnum =
+      pthread_create(&pipe_write->thread, NULL, pipe_write_run, pipe_write);
+  if (errnum != 0) {
+    errno = errnum;
+    return -1;
+  }
+  pipe_write->threaded = true;
+  pipe_writers_push(pipe_write->writers, pipe_write);
+  pipe_write_queue(pipe_write, data + done, len - done);
+  return len;
+}
+
+/// Close the builtin's stream, leaving the rest to the helper thread, if any.
+static int pipe_write_close(void *cookie) {
+  PipeWrite *pipe_write = cookie;
+  if (!pipe_write->threaded) {
+    close(pipe_write->fd);
+    pthread_mutex_destroy(&pipe_write->lock);
+    pthread_cond_destroy(&pipe_write->ready);
+    free(pipe_write);
+    return 0;
+  }
+  pthread_mutex_lock(&pipe_write->lock);
+  pipe_write->closed = true;
+  pthread_cond_signal(&pipe_write->ready);
+  pthread_mutex_unlock(&pipe_write->lock);
+  return 0;
+}
+
+FILE *pipe_writers_open(PipeWriters *writers, int fd) {
+  PipeWrite *pipe_write = malloc(sizeof(PipeWrite));
+  if (pipe_write == NULL) {
+    panic("pipe_writers: failed to allocate memory");
+  }
+  *pipe_write = (PipeWrite){.writers = writers,
+                            .fd = fd,
+                            .threaded = false,
+                            .data = NULL,
+                            .len = 0,
+                            .capacity = 0,
+                            .closed = false,
+                            .broken = false};
+  pthread_mutex_init(&pipe_write->lock, NULL);
+  pthread_cond_init(&pipe_write->ready, NULL);
+  // Writing without blocking tells us when the pipe is full, which is when
+  // the helper thread takes over.
+  if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+    int errnum = errno;
+    pipe_write_close(pipe_write);
+    errno = errnum;
+    return NULL;
+  }
+  cookie_io_functions_t functions = {.read = NULL,
+                                     .write = pipe_write_stream,
+                                     .seek = NULL,
+                                     .close = pipe_write_close};
+  FILE *out = fopencookie(pipe_write, "w", functions);
+  if (out == NULL) {
+    int errnum = errno;
+    pipe_write_close(pipe_write);
+    errno = errnum;
+  }
+  return out;
+}
+
+PipeWriters *pipe_writers_take(PipeWriters *writers) {
+  if (writers->count == 0) {
+    return NULL;
+  }
+  PipeWriters *out = malloc(sizeof(PipeWriters));
+  PipeWrite **writes =
+      malloc(PIPE_WRITERS_START_CAPACITY * sizeof(PipeWrite *));
+  if (out == NULL || writes == NULL) {
+    panic("pipe_writers: failed to allocate memory");
+  }
+  *out = *writers;
+  writers->writes = writes;
+  writers->count = 0;
+  writers->capacity = PIPE_WRITERS_START_CAPACITY;
+  return out;
+}
+
+void pipe_writers_join(PipeWriters *writers) {
+  for (size_t i = 0; i < writers->count; ++i) {
+    PipeWrite *pipe_write = writers->writes[i];
+    pthread_join(pipe_write->thread, NULL);
+    pthread_mutex_destroy(&pipe_write->lock);
+    pthread_cond_destroy(&pipe_write->ready);
+    free(pipe_write->data);
+    free(pipe_write);
+  }
+  writers->count = 0;
+}
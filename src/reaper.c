@@ -0,0 +1,224 @@
+#include "errno.h"
+#include "sys/epoll.h"
+#include "sys/syscall.h"
+#include "sys/wait.h"
+#include "unistd.h"
+
+#include "include/reaper.h"
+
+typedef struct ReaperEntry {
+  pid_t pid;
+  /// The pidfd for this child, or -1 if we couldn't get one.
+  int pidfd;
+  size_t tag;
+  bool reaped;
+} ReaperEntry;
+
+/// How many ready children we collect with a single call to `epoll_wait`.
+#define REAPER_EVENTS 64
+
+struct Reaper {
+  int epoll_fd;
+  /// Every child watched since the last time nothing was pending.
+  ///
+  /// Children are never removed from here, so that events can refer to
+  /// them by index.
+  ReaperEntry *entries;
+  size_t count;
+  size_t capacity;
+  size_t pending;
+  /// Events from the last call to `epoll_wait` we haven't handled yet.
+  struct epoll_event events[REAPER_EVENTS];
+  int event_count;
+  int event_next;
+};
+
+const size_t REAPER_START_CAPACITY = 8;
+
+Reaper *reaper_init() {
+  Reaper *out = malloc(sizeof(Reaper));
+  if (out == NULL) {
+    panic("reaper_init: failed to allocate memory");
+  }
+  // Without epoll, every child falls back to a blocking wait.
+  out->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  out->count = 0;
+  out->capacity = REAPER_START_CAPACITY;
+  out->pending = 0;
+  out->event_count = 0;
+  out->event_next = 0;
+  out->entries = malloc(out->capacity * sizeof(ReaperEntry));
+  if (out->entries == NULL) {
+    panic("reaper_init: failed to allocate memory");
+  }
+  return out;
+}
+
+void reaper_free(Reaper *reaper) {
+  for (size_t i = 0; i < reaper->count; ++i) {
+    if (reaper->entries[i].pidfd != -1) {
+      close(reaper->entries[i].pidfd);
+    }
+  }
+  if (reaper->epoll_fd != -1) {
+    close(reaper->epoll_fd);
+  }
+  free(reaper->entries);
+  free(reaper);
+}
+
+/// Get a pidfd for a child, or -1 if the kernel doesn't support them.
+///
+/// This goes through syscall directly, since older C libraries lack a
+/// wrapper. The descriptor is always close on exec.
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return syscall(SYS_pidfd_open, pid, 0);
+#else
+  (void)pid;
+  return -1;
+#endif
+}
+
+void reaper_watch(Reaper *reaper, pid_t pid, size_t tag) {
+  if (reaper->count >= reaper->capacity) {
+    reaper->capacity *= 2;
+    reaper->entries =
+        realloc(reaper->entries, reaper->capacity * sizeof(ReaperEntry));
+    if (reaper->entries == NULL) {
+      panic("reaper: failed to allocate memory");
+    }
+  }
+  size_t index = reaper->count++;
+  int pidfd = reaper->epoll_fd == -1 ? -1 : open_pidfd(pid);
+  if (pidfd != -1) {
+    struct epoll_event event = {.events = EPOLLIN, .data = {.u64 = index}};
+    if (epoll_ctl(reaper->epoll_fd, EPOLL_CTL_ADD, pidfd, &event) == -1) {
+      close(pidfd);
+      pidfd = -1;
+    }
+  }
+  reaper->entries[index] =
+      (ReaperEntry){.pid = pid, .pidfd = pidfd, .tag = tag, .reaped = false};
+  reaper->pending++;
+}
+
+size_t reaper_pending(Reaper *reaper) {
+  return reaper->pending;
+}
+
+/// Find the next child whose pidfd reports that it has exited.
+///
+/// This waits up to `timeout` milliseconds, like `epoll_wait`, returning NULL
+/// if nothing exited in the meantime.
+static ReaperEntry *reaper_ready(Reaper *reaper, int timeout) {
+  for (;;) {
+    while (reaper->event_next < reaper->event_count) {
+      ReaperEntry *entry =
+          reaper->entries + reaper->events[reaper->event_next++].data.u64;
+      if (!entry->reaped) {
+        return entry;
+      }
+    }
+    int count =
+        epoll_wait(reaper->epoll_fd, reaper->events, REAPER_EVENTS, timeout);
+    if (count == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (timeout == 0) {
+        return NULL;
+      }
+      // We can still fall back to waiting on children one by one.
+      for (size_t i = 0; i < reaper->count; ++i) {
+        if (!reaper->entries[i].reaped) {
+          return reaper->entries + i;
+        }
+      }
+    }
+    if (count == 0 && timeout == 0) {
+      return NULL;
+    }
+    reaper->event_count = count;
+    reaper->event_next = 0;
+  }
+}
+
+/// Find the next child which has exited, or can only be waited on directly.
+static ReaperEntry *reaper_next(Reaper *reaper) {
+  // Children without a pidfd are never reported by epoll.
+  for (size_t i = 0; i < reaper->count; ++i) {
+    ReaperEntry *entry = reaper->entries + i;
+    if (!entry->reaped && entry->pidfd == -1) {
+      return entry;
+    }
+  }
+  return reaper_ready(reaper, -1);
+}
+
+/// Stop watching a child, which is about to be reaped.
+static void reaper_remove(Reaper *reaper, ReaperEntry *entry) {
+  entry->reaped = true;
+  if (entry->pidfd != -1) {
+    close(entry->pidfd);
+    entry->pidfd = -1;
+  }
+  // Once everything has been reaped, the entries can be reused.
+  if (--reaper->pending == 0) {
+    reaper->count = 0;
+    reaper->event_count = 0;
+    reaper->event_next = 0;
+  }
+}
+
+/// Wait for a given child, blocking until it exits.
+static Error reap(pid_t pid, int *status_out) {
+  for (;;) {
+    if (waitpid(pid, status_out, 0) != -1) {
+      return (Error){ERROR_NONE};
+    }
+    if (errno != EINTR) {
+      return error_from_errno(errno);
+    }
+  }
+}
+
+Error reaper_wait(Reaper *reaper, size_t *tag_out, int *status_out) {
+  ReaperEntry *entry = reaper_next(reaper);
+  reaper_remove(reaper, entry);
+  *tag_out = entry->tag;
+  return reap(entry->pid, status_out);
+}
+
+Error reaper_poll(Reaper *reaper, size_t *tag_out, int *status_out,
+                  bool *reaped_out) {
+  *reaped_out = false;
+  // Children without a pidfd have to be asked one by one.
+  for (size_t i = 0; i < reaper->count; ++i) {
+    ReaperEntry *entry = reaper->entries + i;
+    if (entry->reaped || entry->pidfd != -1) {
+      continue;
+    }
+    pid_t pid = waitpid(entry->pid, status_out, WNOHANG);
+    int errnum = errno;
+    if (pid == 0 || (pid == -1 && errnum == EINTR)) {
+      continue;
+    }
+    reaper_remove(reaper, entry);
+    *tag_out = entry->tag;
+    *reaped_out = true;
+    return pid == -1 ? error_from_errno(errnum) : (Error){ERROR_NONE};
+  }
+  if (reaper->pending == 0) {
+    return (Error){ERROR_NONE};
+  }
+  ReaperEntry *entry = reaper_ready(reaper, 0);
+  if (entry == NULL) {
+    return (Error){ERROR_NONE};
+  }
+  reaper_remove(reaper, entry);
+  *tag_out = entry->tag;
+  *reaped_out = true;
+  // The child has exited, so this doesn't block.
+  return reap(entry->pid, status_out);
+}
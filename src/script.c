@@ -0,0 +1,109 @@
+#include "errno.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "unistd.h"
+
+#include "include/bytecode_cache.h"
+#include "include/lexer.h"
+#include "include/parser.h"
+#include "include/script.h"
+#include "include/stats.h"
+#include "include/trace.h"
+
+/// How much we read at once, when a script can't be mapped.
+const size_t SCRIPT_READ_SIZE = 1 << 16;
+
+/// Read everything from a file descriptor, into a buffer allocated with malloc.
+static Error script_read_all(int fd, Script *out) {
+  size_t capacity = SCRIPT_READ_SIZE;
+  size_t len = 0;
+  char *data = malloc(capacity);
+  if (data == NULL) {
+    panic("script: failed to allocate memory");
+  }
+  for (;;) {
+    if (capacity - len < SCRIPT_READ_SIZE) {
+      capacity *= 2;
+      data = realloc(data, capacity);
+      if (data == NULL) {
+        panic("script: failed to allocate memory");
+      }
+    }
+    ssize_t count = read(fd, data + len, capacity - len);
+    if (count == 0) {
+      break;
+    }
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      int errnum = errno;
+      free(data);
+      return error_from_errno(errnum);
+    }
+    len += count;
+  }
+  out->source = (StringSlice){.data = data, .len = len};
+  out->mapped = false;
+  out->mtime = (struct timespec){0, 0};
+  return (Error){ERROR_NONE};
+}
+
+Error script_open(int fd, Script *out) {
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    return error_from_errno(errno);
+  }
+  if (!S_ISREG(info.st_mode) || info.st_size == 0) {
+    return script_read_all(fd, out);
+  }
+  void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    return error_from_errno(errno);
+  }
+  out->source = (StringSlice){.data = data, .len = info.st_size};
+  out->mapped = true;
+  out->mtime = info.st_mtim;
+  return (Error){ERROR_NONE};
+}
+
+void script_close(Script *script) {
+  if (script->mapped) {
+    munmap((void *)script->source.data, script->source.len);
+  } else {
+    free((void *)script->source.data);
+  }
+}
+
+Error script_run(char const *path, Script *script, StringArena *arena,
+                 SymbolTable *symbols, Interpreter *interpreter,
+                 OpBuffer *op_buffer) {
+  bool use_cache = path != NULL && script->mapped && bytecode_cache_enabled();
+  if (use_cache) {
+    BytecodeCacheEntry entry;
+    if (bytecode_cache_load(path, script, arena, &entry)) {
+      op_buffer_link(&entry.ops, arena, symbols);
+      Error error = interpreter_run(interpreter, &entry.ops);
+      bytecode_cache_close(&entry);
+      return error;
+    }
+  }
+
+  Lexer lexer = lexer_init(script->source, arena);
+  Parser parser = parser_init(&lexer, NULL);
+
+  uint64_t start = stats_now();
+  Error error = compile_direct(&parser, op_buffer);
+  stats_record(STATS_PARSE, start);
+  trace_span("compile", start, 0, NULL);
+  if (error.type != ERROR_NONE) {
+    return error;
+  }
+  // The cache is only an optimization, so failing to write to it is fine.
+  if (use_cache) {
+    bytecode_cache_store(path, script, arena, op_buffer);
+  }
+  op_buffer_link(op_buffer, arena, symbols);
+
+  return interpreter_run(interpreter, op_buffer);
+}
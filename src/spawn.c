@@ -0,0 +1,165 @@
+// The system header, rather than include/spawn.h.
+#include <spawn.h>
+
+#include "errno.h"
+#include "fcntl.h"
+#include "stdbool.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+
+#include "include/spawn.h"
+
+SpawnBackend spawn_backend_from_env() {
+  char const *value = getenv("SALLY_SPAWN_BACKEND");
+  if (value == NULL) {
+    return SPAWN_BACKEND_DEFAULT;
+  }
+  if (strcmp(value, "fork") == 0) {
+    return SPAWN_BACKEND_FORK;
+  }
+  if (strcmp(value, "posix_spawn") == 0) {
+    return SPAWN_BACKEND_POSIX_SPAWN;
+  }
+  return SPAWN_BACKEND_DEFAULT;
+}
+
+/// Add the file actions setting up the descriptors of a command.
+static int add_io_actions(posix_spawn_file_actions_t *actions,
+                          SpawnIO const *io) {
+  int errnum = 0;
+  if (io->stdin_fd != -1) {
+    errnum = posix_spawn_file_actions_adddup2(actions, io->stdin_fd,
+                                              STDIN_FILENO);
+    if (errnum != 0) {
+      return errnum;
+    }
+  }
+  if (io->stdout_fd != -1) {
+    errnum = posix_spawn_file_actions_adddup2(actions, io->stdout_fd,
+                                              STDOUT_FILENO);
+    if (errnum != 0) {
+      return errnum;
+    }
+  }
+  if (io->redirects == NULL) {
+    return 0;
+  }
+  int const *string_fd = io->string_fds;
+  for (size_t i = 0; i < io->redirects->count; ++i) {
+    Redirect const *r = io->redirects->redirects + i;
+    switch (r->type) {
+    case REDIRECT_WRITE:
+    case REDIRECT_APPEND:
+    case REDIRECT_READ:
+      errnum = posix_spawn_file_actions_addopen(
+          actions, r->fd, r->data.string, redirect_open_flags(r->type), 0666);
+      break;
+    case REDIRECT_STRING:
+    case REDIRECT_TEMPLATE:
+      errnum = posix_spawn_file_actions_adddup2(actions, *string_fd++, r->fd);
+      break;
+    case REDIRECT_DUP:
+      errnum =
+          posix_spawn_file_actions_adddup2(actions, r->data.source_fd, r->fd);
+      break;
+    }
+    if (errnum != 0) {
+      return errnum;
+    }
+  }
+  return 0;
+}
+
+/// Whether a table has redirects which open files.
+static bool opens_files(RedirectTable const *table) {
+  if (table == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < table->count; ++i) {
+    if (redirect_opens_file(table->redirects[i].type)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Error spawn_command(char const *path, char **argv, char **envp,
+                    SpawnIO const *io, pid_t *pid_out) {
+  posix_spawn_file_actions_t actions;
+  int errnum = posix_spawn_file_actions_init(&actions);
+  if (errnum != 0) {
+    return error_from_errno(errnum);
+  }
+  errnum = add_io_actions(&actions, io);
+  if (errnum == 0) {
+    errnum = posix_spawn(pid_out, path, &actions, NULL, argv, envp);
+  }
+  posix_spawn_file_actions_destroy(&actions);
+  if (errnum == 0) {
+    return (Error){ERROR_NONE};
+  }
+  // The child reports a file it couldn't open just like a program it
+  // couldn't run, but the program can only be blamed if it can't be run.
+  if (opens_files(io->redirects) && errnum != ENOEXEC &&
+      access(path, X_OK) == 0) {
+    return (Error){ERROR_REDIRECT, {.errnum = errnum}};
+  }
+  return error_from_errno(errnum);
+}
+
+/// Make `fd` refer to what `source` does, closing `source` unless it's the
+/// same descriptor.
+static int move_fd(int source, int fd) {
+  if (source == fd) {
+    return 0;
+  }
+  int errnum = dup2(source, fd) == -1 ? errno : 0;
+  close(source);
+  return errnum;
+}
+
+int spawn_io_apply(SpawnIO const *io) {
+  if (io->stdin_fd != -1 && dup2(io->stdin_fd, STDIN_FILENO) == -1) {
+    return errno;
+  }
+  if (io->stdout_fd != -1 && dup2(io->stdout_fd, STDOUT_FILENO) == -1) {
+    return errno;
+  }
+  if (io->redirects == NULL) {
+    return 0;
+  }
+  int const *string_fd = io->string_fds;
+  for (size_t i = 0; i < io->redirects->count; ++i) {
+    Redirect const *r = io->redirects->redirects + i;
+    int source;
+    int errnum;
+    switch (r->type) {
+    case REDIRECT_WRITE:
+    case REDIRECT_APPEND:
+    case REDIRECT_READ:
+      source = open(r->data.string, redirect_open_flags(r->type), 0666);
+      if (source == -1) {
+        return errno;
+      }
+      errnum = move_fd(source, r->fd);
+      if (errnum != 0) {
+        return errnum;
+      }
+      break;
+    case REDIRECT_STRING:
+    case REDIRECT_TEMPLATE:
+      source = *string_fd++;
+      if (dup2(source, r->fd) == -1) {
+        return errno;
+      }
+      break;
+    case REDIRECT_DUP:
+      if (dup2(r->data.source_fd, r->fd) == -1) {
+        return errno;
+      }
+      break;
+    }
+  }
+  return 0;
+}
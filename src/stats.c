@@ -0,0 +1,86 @@
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+#include "include/stats.h"
+
+/// One bucket for each power of two, which covers every 64 bit duration.
+#define STATS_BUCKETS 64
+
+typedef struct Histogram {
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  /// The bucket i counts durations between 2^i and 2^(i+1) nanoseconds.
+  uint64_t buckets[STATS_BUCKETS];
+} Histogram;
+
+static char const *const STAGE_NAMES[STATS_STAGE_COUNT] = {
+    [STATS_PARSE] = "parse",
+    [STATS_LAUNCH] = "launch",
+    [STATS_EXEC_CHECK] = "exec_check",
+    [STATS_WAIT] = "wait",
+};
+
+/// The timings for the whole process, which only ever has one shell.
+static Histogram histograms[STATS_STAGE_COUNT];
+
+uint64_t stats_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void stats_record(StatsStage stage, uint64_t start_ns) {
+  uint64_t elapsed = stats_now() - start_ns;
+  Histogram *histogram = histograms + stage;
+  histogram->count++;
+  histogram->total_ns += elapsed;
+  if (elapsed > histogram->max_ns) {
+    histogram->max_ns = elapsed;
+  }
+  // The position of the highest set bit is the bucket, with 0 in the first.
+  int bucket = elapsed == 0 ? 0 : 63 - __builtin_clzll(elapsed);
+  histogram->buckets[bucket]++;
+}
+
+void stats_reset() {
+  memset(histograms, 0, sizeof(histograms));
+}
+
+/// Find the upper bound of the bucket a percentile falls in.
+static uint64_t percentile(Histogram *histogram, uint64_t percent) {
+  // The rank of the percentile, rounded up, so that it's always at least 1.
+  uint64_t rank = (histogram->count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (int i = 0; i < STATS_BUCKETS; ++i) {
+    seen += histogram->buckets[i];
+    if (seen >= rank) {
+      uint64_t end = i == STATS_BUCKETS - 1 ? UINT64_MAX : 2ull << i;
+      return end < histogram->max_ns ? end : histogram->max_ns;
+    }
+  }
+  return histogram->max_ns;
+}
+
+void stats_print(FILE *out) {
+  fputs("stage\tcount\tmean_us\tp50_us\tp99_us\tmax_us\n", out);
+  for (int i = 0; i < STATS_STAGE_COUNT; ++i) {
+    Histogram *histogram = histograms + i;
+    if (histogram->count == 0) {
+      fprintf(out, "%s\t0\t-\t-\t-\t-\n", STAGE_NAMES[i]);
+      continue;
+    }
+    fprintf(out, "%s\t%llu\t%.1f\t%.1f\t%.1f\t%.1f\n", STAGE_NAMES[i],
+            (unsigned long long)histogram->count,
+            (double)histogram->total_ns / (double)histogram->count / 1e3,
+            (double)percentile(histogram, 50) / 1e3,
+            (double)percentile(histogram, 99) / 1e3,
+            (double)histogram->max_ns / 1e3);
+  }
+}
+
+bool stats_dump_enabled() {
+  char const *value = getenv("SALLY_STATS");
+  return value != NULL && value[0] != 0 && strcmp(value, "0") != 0;
+}
@@ -65,6 +65,82 @@ StringHandle string_arena_alloc(StringArena *arena, StringSlice slice) {
   return old_start;
 }
 
+StringHandle string_arena_begin(StringArena *arena) {
+  return arena->start;
+}
+
+void string_arena_append(StringArena *arena, StringSlice slice) {
+  size_t required = arena->start + slice.len;
+  if (required > arena->size) {
+    string_arena_resize(arena, required);
+  }
+  memcpy(arena->buffer + arena->start, slice.data, slice.len);
+  arena->start += slice.len;
+}
+
+void string_arena_end(StringArena *arena) {
+  string_arena_append(arena, (StringSlice){.data = "", .len = 1});
+}
+
+// Linking replaces each handle with a pointer of the same size.
+_Static_assert(sizeof(StringHandle) == sizeof(char *),
+               "handles and pointers need to have the same size");
+
+StringHandle string_arena_reserve(StringArena *arena, size_t size) {
+  size_t align = _Alignof(char *);
+  size_t start = (arena->start + align - 1) & ~(align - 1);
+  size_t required = start + size;
+  if (required > arena->size) {
+    string_arena_resize(arena, required);
+  }
+  arena->start = required;
+  return start;
+}
+
+void *string_arena_get_data(StringArena *arena, StringHandle handle) {
+  assert(handle < arena->size);
+  return arena->buffer + handle;
+}
+
+StringHandle string_arena_alloc_argv(StringArena *arena,
+                                     StringHandle const *handles,
+                                     size_t count) {
+  StringHandle start =
+      string_arena_reserve(arena, count * sizeof(StringHandle));
+  memcpy(arena->buffer + start, handles, count * sizeof(StringHandle));
+  return start;
+}
+
+void string_arena_link_argv(StringArena *arena, StringHandle argv,
+                            size_t count) {
+  assert(argv + count * sizeof(StringHandle) <= arena->start);
+  // Going through memcpy keeps this clear of strict aliasing.
+  char *at = arena->buffer + argv;
+  for (size_t i = 0; i < count; ++i, at += sizeof(StringHandle)) {
+    StringHandle handle;
+    memcpy(&handle, at, sizeof(StringHandle));
+    char *string = handle == STRING_HANDLE_NULL ? NULL : arena->buffer + handle;
+    memcpy(at, &string, sizeof(char *));
+  }
+}
+
+char **string_arena_get_argv(StringArena *arena, StringHandle argv) {
+  assert(argv < arena->size);
+  return (char **)(arena->buffer + argv);
+}
+
+StringSlice string_arena_contents(StringArena *arena) {
+  return (StringSlice){.data = arena->buffer, .len = arena->start};
+}
+
+void string_arena_load(StringArena *arena, StringSlice contents) {
+  if (contents.len > arena->size) {
+    string_arena_resize(arena, contents.len);
+  }
+  memcpy(arena->buffer, contents.data, contents.len);
+  arena->start = contents.len;
+}
+
 char *string_arena_get_str(StringArena *arena, StringHandle handle) {
   assert(handle < arena->size);
   return arena->buffer + handle;
@@ -0,0 +1,365 @@
+#include "stdlib.h"
+#include "string.h"
+
+#include "include/error.h"
+#include "include/symbol_table.h"
+
+typedef struct SymbolEntry {
+  /// The offset of the name of this symbol, in the names buffer.
+  size_t name;
+  size_t name_len;
+  uint64_t hash;
+  /// The variable as a `NAME=value` string, which is what goes in the
+  /// environment, or NULL if it has never been set.
+  char *binding;
+  /// The size of the allocation behind binding.
+  size_t binding_capacity;
+  /// The value, inside of binding, or NULL if the variable isn't set.
+  char *value;
+  size_t value_len;
+  bool exported;
+  /// The position of binding in the environment, or `ENV_NONE`.
+  size_t env_index;
+} SymbolEntry;
+
+struct SymbolTable {
+  /// Every name, each followed by a null terminator.
+  char *names;
+  size_t names_len;
+  size_t names_capacity;
+  /// The entry of each symbol, indexed by that symbol.
+  SymbolEntry *entries;
+  size_t entries_len;
+  size_t entries_capacity;
+  /// The hash table mapping names to symbols, holding `SYMBOL_NONE` in empty
+  /// slots.
+  Symbol *slots;
+  /// The number of slots, always a power of 2.
+  size_t slots_capacity;
+  /// The environment of commands: the binding of every exported variable
+  /// which is set, followed by NULL.
+  ///
+  /// This starts after `env_front` empty slots, where an overlay puts the
+  /// bindings it adds, so that they never need the rest to be copied.
+  char **env;
+  size_t env_front;
+  size_t env_len;
+  size_t env_capacity;
+  /// The symbol of each binding in the environment.
+  Symbol *env_symbols;
+  /// Where the environment starts, in front of it while an overlay is on.
+  size_t env_start;
+};
+
+const size_t SYMBOL_TABLE_START_CAPACITY = 64;
+const size_t ENV_FRONT_START_CAPACITY = 8;
+#define ENV_NONE ((size_t)-1)
+
+static void *allocate(size_t size) {
+  void *out = malloc(size);
+  if (out == NULL) {
+    panic("symbol_table: failed to allocate memory");
+  }
+  return out;
+}
+
+static Symbol *allocate_slots(size_t capacity) {
+  Symbol *slots = allocate(capacity * sizeof(Symbol));
+  // Every byte of SYMBOL_NONE is 0xFF.
+  memset(slots, 0xFF, capacity * sizeof(Symbol));
+  return slots;
+}
+
+SymbolTable *symbol_table_init() {
+  SymbolTable *out = allocate(sizeof(SymbolTable));
+  out->names_capacity = SYMBOL_TABLE_START_CAPACITY * 8;
+  out->names = allocate(out->names_capacity);
+  out->names_len = 0;
+  out->entries_capacity = SYMBOL_TABLE_START_CAPACITY / 2;
+  out->entries = allocate(out->entries_capacity * sizeof(SymbolEntry));
+  out->entries_len = 0;
+  out->slots_capacity = SYMBOL_TABLE_START_CAPACITY;
+  out->slots = allocate_slots(out->slots_capacity);
+  out->env_front = ENV_FRONT_START_CAPACITY;
+  out->env_len = 0;
+  out->env_capacity = SYMBOL_TABLE_START_CAPACITY;
+  out->env = allocate((out->env_front + out->env_capacity) * sizeof(char *));
+  out->env_symbols = allocate(out->env_capacity * sizeof(Symbol));
+  out->env[out->env_front] = NULL;
+  out->env_start = out->env_front;
+  return out;
+}
+
+void symbol_table_free(SymbolTable *table) {
+  for (size_t i = 0; i < table->entries_len; ++i) {
+    free(table->entries[i].binding);
+  }
+  free(table->names);
+  free(table->entries);
+  free(table->slots);
+  free(table->env);
+  free(table->env_symbols);
+  free(table);
+}
+
+/// FNV-1a, like the command cache uses.
+static uint64_t hash_name(StringSlice name) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < name.len; ++i) {
+    hash ^= (unsigned char)name.data[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+/// Find the slot for a name.
+///
+/// This returns either the slot containing the symbol for that name, or the
+/// empty slot where it should be inserted.
+static Symbol *symbol_table_slot(SymbolTable *table, StringSlice name,
+                                 uint64_t hash) {
+  size_t mask = table->slots_capacity - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    Symbol *slot = table->slots + i;
+    if (*slot == SYMBOL_NONE) {
+      return slot;
+    }
+    SymbolEntry *entry = table->entries + *slot;
+    if (entry->hash == hash && entry->name_len == name.len &&
+        memcmp(table->names + entry->name, name.data, name.len) == 0) {
+      return slot;
+    }
+  }
+}
+
+static void symbol_table_grow(SymbolTable *table) {
+  free(table->slots);
+  table->slots_capacity *= 2;
+  table->slots = allocate_slots(table->slots_capacity);
+  size_t mask = table->slots_capacity - 1;
+  // Names are unique, so each one just goes in the first empty slot.
+  for (Symbol symbol = 0; symbol < table->entries_len; ++symbol) {
+    size_t i = table->entries[symbol].hash & mask;
+    while (table->slots[i] != SYMBOL_NONE) {
+      i = (i + 1) & mask;
+    }
+    table->slots[i] = symbol;
+  }
+}
+
+Symbol symbol_table_intern(SymbolTable *table, StringSlice name) {
+  uint64_t hash = hash_name(name);
+  Symbol *slot = symbol_table_slot(table, name, hash);
+  if (*slot != SYMBOL_NONE) {
+    return *slot;
+  }
+
+  if (table->names_len + name.len + 1 > table->names_capacity) {
+    while (table->names_len + name.len + 1 > table->names_capacity) {
+      table->names_capacity *= 2;
+    }
+    table->names = realloc(table->names, table->names_capacity);
+    if (table->names == NULL) {
+      panic("symbol_table: failed to allocate memory");
+    }
+  }
+  if (table->entries_len >= table->entries_capacity) {
+    table->entries_capacity *= 2;
+    table->entries = realloc(table->entries,
+                             table->entries_capacity * sizeof(SymbolEntry));
+    if (table->entries == NULL) {
+      panic("symbol_table: failed to allocate memory");
+    }
+  }
+
+  Symbol symbol = table->entries_len++;
+  table->entries[symbol] = (SymbolEntry){.name = table->names_len,
+                                         .name_len = name.len,
+                                         .hash = hash,
+                                         .binding = NULL,
+                                         .binding_capacity = 0,
+                                         .value = NULL,
+                                         .value_len = 0,
+                                         .exported = false,
+                                         .env_index = ENV_NONE};
+  memcpy(table->names + table->names_len, name.data, name.len);
+  table->names[table->names_len + name.len] = 0;
+  table->names_len += name.len + 1;
+
+  *slot = symbol;
+  // Keep the table at most half full, so that probe sequences stay short.
+  if (2 * table->entries_len > table->slots_capacity) {
+    symbol_table_grow(table);
+  }
+  return symbol;
+}
+
+size_t symbol_table_count(SymbolTable *table) { return table->entries_len; }
+
+char const *symbol_table_name(SymbolTable *table, Symbol symbol) {
+  return table->names + table->entries[symbol].name;
+}
+
+StringSlice symbol_table_get(SymbolTable *table, Symbol symbol) {
+  SymbolEntry *entry = table->entries + symbol;
+  return (StringSlice){.data = entry->value, .len = entry->value_len};
+}
+
+/// Add the binding of a variable to the end of the environment.
+static void env_push(SymbolTable *table, Symbol symbol) {
+  if (table->env_len + 1 >= table->env_capacity) {
+    table->env_capacity *= 2;
+    table->env = realloc(table->env, (table->env_front + table->env_capacity) *
+                                         sizeof(char *));
+    table->env_symbols = realloc(table->env_symbols,
+                                 table->env_capacity * sizeof(Symbol));
+    if (table->env == NULL || table->env_symbols == NULL) {
+      panic("symbol_table: failed to allocate memory");
+    }
+  }
+  SymbolEntry *entry = table->entries + symbol;
+  entry->env_index = table->env_len;
+  table->env_symbols[table->env_len] = symbol;
+  char **env = table->env + table->env_front;
+  env[table->env_len++] = entry->binding;
+  env[table->env_len] = NULL;
+}
+
+/// Remove the binding of a variable from the environment, moving the last
+/// binding into its place.
+static void env_remove(SymbolTable *table, Symbol symbol) {
+  SymbolEntry *entry = table->entries + symbol;
+  size_t last = --table->env_len;
+  char **env = table->env + table->env_front;
+  Symbol moved = table->env_symbols[last];
+  env[entry->env_index] = env[last];
+  table->env_symbols[entry->env_index] = moved;
+  table->entries[moved].env_index = entry->env_index;
+  env[last] = NULL;
+  entry->env_index = ENV_NONE;
+}
+
+void symbol_table_set(SymbolTable *table, Symbol symbol, StringSlice value) {
+  SymbolEntry *entry = table->entries + symbol;
+  size_t size = entry->name_len + 1 + value.len + 1;
+  if (size > entry->binding_capacity) {
+    size_t capacity =
+        entry->binding_capacity == 0 ? 16 : entry->binding_capacity;
+    while (size > capacity) {
+      capacity *= 2;
+    }
+    // The old value might be what we're setting, so it can't be freed first.
+    char *buffer = allocate(capacity);
+    memcpy(buffer, table->names + entry->name, entry->name_len);
+    buffer[entry->name_len] = '=';
+    memcpy(buffer + entry->name_len + 1, value.data, value.len);
+    free(entry->binding);
+    entry->binding = buffer;
+    entry->binding_capacity = capacity;
+    if (entry->env_index != ENV_NONE) {
+      table->env[table->env_front + entry->env_index] = buffer;
+    }
+  } else {
+    memmove(entry->binding + entry->name_len + 1, value.data, value.len);
+  }
+  entry->value = entry->binding + entry->name_len + 1;
+  entry->value[value.len] = 0;
+  entry->value_len = value.len;
+  if (entry->exported && entry->env_index == ENV_NONE) {
+    env_push(table, symbol);
+  }
+}
+
+void symbol_table_unset(SymbolTable *table, Symbol symbol) {
+  SymbolEntry *entry = table->entries + symbol;
+  if (entry->env_index != ENV_NONE) {
+    env_remove(table, symbol);
+  }
+  // The binding is kept around, to be reused if the variable is set again.
+  entry->value = NULL;
+  entry->value_len = 0;
+  entry->exported = false;
+}
+
+void symbol_table_export(SymbolTable *table, Symbol symbol) {
+  SymbolEntry *entry = table->entries + symbol;
+  entry->exported = true;
+  if (entry->value != NULL && entry->env_index == ENV_NONE) {
+    env_push(table, symbol);
+  }
+}
+
+bool symbol_table_exported(SymbolTable *table, Symbol symbol) {
+  return table->entries[symbol].exported;
+}
+
+char **symbol_table_environ(SymbolTable *table) {
+  return table->env + table->env_start;
+}
+
+void symbol_table_overlay(SymbolTable *table, Symbol const *symbols,
+                          char *const *bindings, size_t count) {
+  if (count > table->env_front) {
+    size_t front = table->env_front;
+    while (count > front) {
+      front *= 2;
+    }
+    table->env = realloc(table->env, (front + table->env_capacity) *
+                                         sizeof(char *));
+    if (table->env == NULL) {
+      panic("symbol_table: failed to allocate memory");
+    }
+    memmove(table->env + front, table->env + table->env_front,
+            (table->env_len + 1) * sizeof(char *));
+    table->env_front = front;
+  }
+  table->env_start = table->env_front;
+  for (size_t i = 0; i < count; ++i) {
+    SymbolEntry *entry = table->entries + symbols[i];
+    if (entry->env_index != ENV_NONE) {
+      table->env[table->env_front + entry->env_index] = bindings[i];
+      continue;
+    }
+    // A variable given twice keeps its last binding, in the same slot.
+    char **slot = table->env + table->env_start;
+    char const *name = table->names + entry->name;
+    for (; slot < table->env + table->env_front; ++slot) {
+      if (strncmp(*slot, name, entry->name_len) == 0 &&
+          (*slot)[entry->name_len] == '=') {
+        break;
+      }
+    }
+    if (slot == table->env + table->env_front) {
+      slot = table->env + --table->env_start;
+    }
+    *slot = bindings[i];
+  }
+}
+
+void symbol_table_restore(SymbolTable *table, Symbol const *symbols,
+                          size_t count) {
+  // Each variable gets its own binding back, wherever it is now, in case it
+  // was set, or another one was unset, while the overlay was on.
+  for (size_t i = 0; i < count; ++i) {
+    SymbolEntry *entry = table->entries + symbols[i];
+    if (entry->env_index != ENV_NONE) {
+      table->env[table->env_front + entry->env_index] = entry->binding;
+    }
+  }
+  table->env_start = table->env_front;
+}
+
+void symbol_table_import(SymbolTable *table, char **envp) {
+  for (; *envp != NULL; ++envp) {
+    char const *equals = strchr(*envp, '=');
+    if (equals == NULL) {
+      continue;
+    }
+    StringSlice name = {.data = *envp, .len = (size_t)(equals - *envp)};
+    Symbol symbol = symbol_table_intern(table, name);
+    symbol_table_set(table, symbol,
+                     (StringSlice){.data = equals + 1,
+                                   .len = strlen(equals + 1)});
+    symbol_table_export(table, symbol);
+  }
+}
@@ -0,0 +1,183 @@
+#include "errno.h"
+#include "fcntl.h"
+#include "stdarg.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+
+#include "include/error.h"
+#include "include/stats.h"
+#include "include/trace.h"
+
+/// How many bytes of events we buffer before writing them out.
+const size_t TRACE_FLUSH_SIZE = 1 << 20;
+
+typedef struct Trace {
+  int fd;
+  pid_t pid;
+  /// The time the trace started, which timestamps are relative to.
+  uint64_t start_ns;
+  char *buf;
+  size_t len;
+  size_t capacity;
+  /// Whether or not an event was written yet, to place commas.
+  bool has_events;
+} Trace;
+
+/// The trace for the whole process, with a file descriptor of -1 if disabled.
+static Trace trace = {.fd = -1};
+
+/// Write an entire buffer, giving up on the trace if that fails.
+static void trace_write(char const *data, size_t len) {
+  while (len > 0 && trace.fd != -1) {
+    ssize_t count = write(trace.fd, data, len);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      close(trace.fd);
+      trace.fd = -1;
+      return;
+    }
+    data += count;
+    len -= count;
+  }
+}
+
+static void trace_reserve(size_t extra) {
+  if (trace.len + extra <= trace.capacity) {
+    return;
+  }
+  while (trace.len + extra > trace.capacity) {
+    trace.capacity *= 2;
+  }
+  trace.buf = realloc(trace.buf, trace.capacity);
+  if (trace.buf == NULL) {
+    panic("trace: failed to allocate memory");
+  }
+}
+
+static void trace_printf(char const *format, ...) {
+  for (;;) {
+    va_list args;
+    va_start(args, format);
+    size_t available = trace.capacity - trace.len;
+    int written = vsnprintf(trace.buf + trace.len, available, format, args);
+    va_end(args);
+    if ((size_t)written < available) {
+      trace.len += written;
+      return;
+    }
+    trace_reserve(written + 1);
+  }
+}
+
+/// Append a string, escaped to fit inside of a JSON string.
+static void trace_escaped(char const *str) {
+  for (; *str != 0; ++str) {
+    unsigned char c = *str;
+    if (c == '"' || c == '\\') {
+      trace_printf("\\%c", c);
+    } else if (c < 0x20) {
+      trace_printf("\\u%04x", c);
+    } else {
+      trace_reserve(1);
+      trace.buf[trace.len++] = c;
+    }
+  }
+}
+
+void trace_init() {
+  char const *path = getenv("SALLY_TRACE");
+  if (path == NULL || path[0] == 0) {
+    return;
+  }
+  trace.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (trace.fd == -1) {
+    perror(path);
+    return;
+  }
+  trace.pid = getpid();
+  trace.start_ns = stats_now();
+  trace.len = 0;
+  trace.capacity = TRACE_FLUSH_SIZE;
+  trace.buf = malloc(trace.capacity);
+  if (trace.buf == NULL) {
+    panic("trace_init: failed to allocate memory");
+  }
+  trace.has_events = false;
+  trace_printf("{\"traceEvents\":[\n");
+}
+
+bool trace_enabled() {
+  return trace.fd != -1;
+}
+
+void trace_span(char const *name, uint64_t start_ns, pid_t track,
+                TraceArgs const *args) {
+  if (trace.fd == -1) {
+    return;
+  }
+  uint64_t end_ns = stats_now();
+  trace_printf("%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+               "\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+               trace.has_events ? ",\n" : "", name, (int)trace.pid,
+               (int)(track == 0 ? trace.pid : track),
+               (double)(start_ns - trace.start_ns) / 1e3,
+               (double)(end_ns - start_ns) / 1e3);
+  trace.has_events = true;
+  if (args != NULL) {
+    char const *separator = "";
+    if (args->pid != 0) {
+      trace_printf("\"pid\":%d", (int)args->pid);
+      separator = ",";
+    }
+    if (args->argv0 != NULL) {
+      trace_printf("%s\"argv0\":\"", separator);
+      trace_escaped(args->argv0);
+      trace_printf("\",\"stage\":%zu", args->stage);
+      separator = ",";
+    }
+    if (args->redirects != NULL) {
+      trace_printf("%s\"files\":[", separator);
+      char const *file_separator = "";
+      for (size_t i = 0; i < args->redirects->count; ++i) {
+        Redirect const *r = args->redirects->redirects + i;
+        if (redirect_opens_file(r->type)) {
+          trace_printf("%s\"", file_separator);
+          trace_escaped(r->data.string);
+          trace_printf("\"");
+          file_separator = ",";
+        }
+      }
+      trace_printf("]");
+    }
+  }
+  trace_printf("}}");
+}
+
+void trace_flush_if_full() {
+  if (trace.fd == -1 || trace.len < TRACE_FLUSH_SIZE / 2) {
+    return;
+  }
+  trace_write(trace.buf, trace.len);
+  trace.len = 0;
+}
+
+void trace_finish() {
+  // A failed write stops tracing, but the buffer still has to be freed.
+  if (trace.buf == NULL) {
+    return;
+  }
+  if (trace.fd != -1) {
+    trace_printf("\n]}\n");
+    trace_write(trace.buf, trace.len);
+  }
+  if (trace.fd != -1) {
+    close(trace.fd);
+    trace.fd = -1;
+  }
+  free(trace.buf);
+  trace.buf = NULL;
+}